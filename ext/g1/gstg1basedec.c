@@ -32,18 +32,19 @@
 #include "gstg1format.h"
 #include "gstg1enum.h"
 #include "gstkmsallocator.h"
+#include "gstkmsbufferpool.h"
+#include "gstg1bufferpool.h"
+#include "gstg1scheduler.h"
 #include <string.h>
 #include <stdio.h>
 
-#define Y 0
-#define CbCr 1
-
 int divRoundClosest (const int, const int);
 
 enum
 {
   PROP_0,
   PROP_ROTATION,
+  PROP_DEINTERLACE,
   PROP_BRIGHTNESS,
   PROP_CONTRAST,
   PROP_SATURATION,
@@ -51,6 +52,8 @@ enum
   PROP_CROP_Y,
   PROP_CROP_WIDTH,
   PROP_CROP_HEIGHT,
+  PROP_ROI_CROP,
+  PROP_ROI_TYPE,
   PROP_X,
   PROP_Y,
   PROP_W,
@@ -60,9 +63,21 @@ enum
   PROP_MASK1_Y,
   PROP_MASK1_WIDTH,
   PROP_MASK1_HEIGHT,
+  PROP_INPUT_RING_SIZE,
+  PROP_ASYNC_DECODE,
+  PROP_PP_MULTIBUFFER,
+  PROP_MAX_WIDTH,
+  PROP_MAX_HEIGHT,
+  PROP_PRIORITY,
+  PROP_SCHEDULING,
+  PROP_HARDWARE_TIME,
+  PROP_QOS,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
 };
 
 #define PROP_DEFAULT_ROTATION PP_ROTATION_NONE
+#define PROP_DEFAULT_DEINTERLACE GST_G1_DEINTERLACE_AUTO
 #define PROP_DEFAULT_BRIGHTNESS 0
 #define PROP_DEFAULT_CONTRAST 0
 #define PROP_DEFAULT_SATURATION 0
@@ -70,6 +85,8 @@ enum
 #define PROP_DEFAULT_CROP_Y 0
 #define PROP_DEFAULT_CROP_WIDTH  0
 #define PROP_DEFAULT_CROP_HEIGHT 0
+#define PROP_DEFAULT_ROI_CROP FALSE
+#define PROP_DEFAULT_ROI_TYPE NULL
 #define PROP_DEFAULT_MASK1_LOCATION NULL
 #define PROP_DEFAULT_MASK1_X 0
 #define PROP_DEFAULT_MASK1_Y 0
@@ -77,14 +94,157 @@ enum
 #define PROP_DEFAULT_MASK1_HEIGHT 0
 #define PROP_DEFAULT_X 0
 #define PROP_DEFAULT_Y 0
+#define PROP_DEFAULT_INPUT_RING_SIZE 0
+#define PROP_DEFAULT_ASYNC_DECODE FALSE
+#define PROP_DEFAULT_PP_MULTIBUFFER FALSE
+#define PROP_DEFAULT_MAX_WIDTH 0
+#define PROP_DEFAULT_MAX_HEIGHT 0
+#define PROP_DEFAULT_PRIORITY 0
+#define PROP_DEFAULT_SCHEDULING GST_G1_SCHEDULER_ROUND_ROBIN
+#define PROP_DEFAULT_QOS TRUE
+#define PROP_DEFAULT_STATS_INTERVAL 0
+
+/* Minimum amount of output buffers preallocated in the G1 pool */
+#define OUTPUT_POOL_MIN_BUFFERS 2
+
+/* Input bitstream buffers proposed upstream */
+#define INPUT_POOL_MIN_BUFFERS 2
+#define INPUT_POOL_DEFAULT_SIZE (512 * 1024)
+
+/* Access units are placed in the input ring at this alignment */
+#define INPUT_RING_ALIGN 8
+
+/* Frames waiting for the worker thread in asynchronous mode */
+#define ASYNC_QUEUE_SIZE 4
+
+/* Buffers preallocated for the analytics pad */
+#define ANALYTICS_POOL_MIN_BUFFERS 2
+
+/* Upper bounds of the stage timing histogram buckets, the last bucket
+   takes everything slower */
+static const GstClockTime stats_bounds[GST_G1_BASE_DEC_STATS_BUCKETS - 1] = {
+  1 * GST_MSECOND, 2 * GST_MSECOND, 5 * GST_MSECOND, 10 * GST_MSECOND,
+  20 * GST_MSECOND, 50 * GST_MSECOND, 100 * GST_MSECOND
+};
+
+static const gchar *stats_stages[GST_G1_BASE_DEC_N_STAGES] = {
+  "copy", "decode", "pp", "push"
+};
+
+static const gchar *stats_counters[GST_G1_BASE_DEC_N_COUNTERS] = {
+  "concealed-mbs", "skipped-pictures", "bytes-copied"
+};
+
+/* Segment flags of trick mode playback, older versions only know skip
+   seeks. Dropping only the audio doesn't make it a video trick mode */
+#if GST_CHECK_VERSION(1,6,0)
+#define SEGMENT_FLAG_KEY_UNITS GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS
+#define SEGMENT_FLAGS_TRICKMODE (GST_SEGMENT_FLAG_TRICKMODE | \
+    GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS)
+#else
+#define SEGMENT_FLAG_KEY_UNITS 0
+#define SEGMENT_FLAGS_TRICKMODE GST_SEGMENT_FLAG_SKIP
+#endif
+
+/* Sections of the post processor configuration changed since it was
+   last programmed */
+enum
+{
+  PP_DIRTY_INPUT = 1 << 0,
+  PP_DIRTY_CROP = 1 << 1,
+  PP_DIRTY_ROTATION = 1 << 2,
+  PP_DIRTY_COLOR = 1 << 3,
+  PP_DIRTY_MASK1 = 1 << 4,
+  PP_DIRTY_OUTPUT = 1 << 5,
+  PP_DIRTY_MASK2 = 1 << 6,
+  PP_DIRTY_DEINTERLACE = 1 << 7,
+};
+
+#define PP_DIRTY_ALL (PP_DIRTY_INPUT | PP_DIRTY_CROP | PP_DIRTY_ROTATION | \
+    PP_DIRTY_COLOR | PP_DIRTY_MASK1 | PP_DIRTY_OUTPUT | PP_DIRTY_MASK2 | \
+    PP_DIRTY_DEINTERLACE)
+
+/* Structure name of the custom events setting the crop window */
+#define CROP_EVENT_NAME "g1-crop"
+
+/* Structure name of the custom events setting the overlay composition */
+#define OVERLAY_EVENT_NAME "g1-overlay"
+
+/* Crop window of a frame, taken from its region of interest */
+typedef struct
+{
+  guint x;
+  guint y;
+  guint width;
+  guint height;
+} GstG1BaseDecCrop;
+
+/* Per frame post processor settings, taken from its input buffer and
+   the events before it, and applied when its output is allocated */
+typedef struct
+{
+  gboolean cropped;
+  GstG1BaseDecCrop crop;
+  GstVideoOverlayComposition *overlay;
+} GstG1BaseDecFrameData;
+
+/* Blending of an overlay rectangle with a post processor mask, both
+   masks have the same layout but not the same type */
+#define PP_MASK_BLEND(mask, x, y, width, height, blendx, blendy, \
+    blendwidth, blendheight, base) G_STMT_START { \
+  (mask).enable = 1; \
+  (mask).alphaBlendEna = 1; \
+  (mask).originX = (x); \
+  (mask).originY = (y); \
+  (mask).width = (width); \
+  (mask).height = (height); \
+  (mask).blendOriginX = (blendx); \
+  (mask).blendOriginY = (blendy); \
+  (mask).blendWidth = (blendwidth); \
+  (mask).blendHeight = (blendheight); \
+  (mask).blendComponentBase = (base); \
+} G_STMT_END
+
+/* A decoded picture to push downstream, or a frame the hardware is done
+   with, waiting for the streaming thread in asynchronous mode */
+typedef struct
+{
+  GstVideoCodecFrame *frame;
+  gboolean finish;
+  gboolean interlaced;
+  GstBuffer *analytics;
+} GstG1BaseDecOutput;
+
+/* A codec picture downstream holds without a copy */
+typedef struct
+{
+  GstG1BaseDec *dec;
+  gpointer virtaddress;
+} GstG1BaseDecNative;
+
+/* A buffer of the post processor ring downstream holds, which stays in
+   the ring at index */
+typedef struct
+{
+  GstG1BaseDec *dec;
+  GstBuffer *buffer;
+  guint index;
+} GstG1BaseDecSlot;
 
 /* TODO: There are non standard formats missing, add them! */
 static GstStaticPadTemplate gst_g1_base_dec_src_pad_template =
 GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE
-        ("{ GRAY8, YUY2, YVYU, UYVY, NV16, I420, NV12, RGB15, RGB16, BGR15, BGR16, RGBx, BGRx }")));
+    GST_STATIC_CAPS (GST_G1_BASE_DEC_SRC_CAPS));
+
+/* Second output, written by another post processor pass over the
+   pictures of the first one */
+static GstStaticPadTemplate gst_g1_base_dec_analytics_pad_template =
+GST_STATIC_PAD_TEMPLATE ("analytics",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (GST_G1_BASE_DEC_SRC_CAPS));
 
 GST_DEBUG_CATEGORY_STATIC (g1_base_dec_debug);
 #define GST_CAT_DEFAULT g1_base_dec_debug
@@ -100,7 +260,20 @@ static void gst_g1_base_dec_get_property (GObject * object, guint prop_id,
 static void gst_g1_base_dec_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 
+static void gst_g1_base_dec_finalize (GObject * object);
+static GstPad *gst_g1_base_dec_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_g1_base_dec_release_pad (GstElement * element, GstPad * pad);
+
 static gboolean gst_g1_base_dec_open (GstVideoDecoder * decoder);
+static gboolean gst_g1_base_dec_stop (GstVideoDecoder * decoder);
+static GstFlowReturn gst_g1_base_dec_finish (GstVideoDecoder * decoder);
+static GstFlowReturn gst_g1_base_dec_drain (GstVideoDecoder * decoder);
+static gboolean gst_g1_base_dec_flush (GstVideoDecoder * decoder);
+static gboolean gst_g1_base_dec_src_event (GstVideoDecoder * decoder,
+    GstEvent * event);
+static gboolean gst_g1_base_dec_sink_event (GstVideoDecoder * decoder,
+    GstEvent * event);
 static GstFlowReturn gst_g1_base_dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame);
 static gboolean gst_g1_base_dec_set_format (GstVideoDecoder * decoder,
@@ -115,9 +288,44 @@ static gboolean gst_g1_base_dec_sink_query (GstVideoDecoder * decoder,
 
 static gboolean gst_g1_base_dec_copy_memory (GstG1BaseDec * dec,
     GstMemory ** dst, GstMemory * src);
+static gboolean gst_g1_base_dec_ring_memory (GstG1BaseDec * dec,
+    GstMemory ** dst, GstMemory * src);
+static GstFlowReturn gst_g1_base_dec_async_decode (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame);
+static GstFlowReturn gst_g1_base_dec_async_wait (GstG1BaseDec * dec,
+    guint pending);
+static void gst_g1_base_dec_native_wait (GstG1BaseDec * dec,
+    gboolean all);
+static void gst_g1_base_dec_async_flush (GstG1BaseDec * dec,
+    gboolean start);
+static void gst_g1_base_dec_stop_worker (GstG1BaseDec * dec);
+static gboolean gst_g1_base_dec_frame_done (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame);
+static void gst_g1_base_dec_release_frame (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame);
+static void gst_g1_base_dec_reset_multibuffer (GstG1BaseDec * dec);
+static void gst_g1_base_dec_resize_drain (GstG1BaseDec * dec);
+static void gst_g1_base_dec_resize_output (GstG1BaseDec * dec,
+    gboolean resized, gint32 width, gint32 height);
+static gboolean gst_g1_base_dec_can_bypass (GstG1BaseDec * dec,
+    GstVideoInfo * vinfo);
+static void gst_g1_base_dec_reset_stats (GstG1BaseDec * dec);
+static void gst_g1_base_dec_config_roi (GstG1BaseDec * dec,
+    GstVideoInfo * vinfo, GstG1BaseDecCrop * crop);
+static void gst_g1_base_dec_config_overlay (GstG1BaseDec * dec,
+    GstVideoInfo * vinfo, GstVideoOverlayComposition * overlay);
+static void gst_g1_base_dec_output_interlace (GstG1BaseDec * dec,
+    gboolean interlaced);
+static void gst_g1_base_dec_record (GstG1BaseDec * dec,
+    GstG1BaseDecStage stage, GstClockTime elapsed);
+static GstStructure *gst_g1_base_dec_stats (GstG1BaseDec * dec);
+static void gst_g1_base_dec_frame_stats (GstG1BaseDec * dec);
+static gboolean gst_g1_base_dec_config_bypass (GstG1BaseDec * dec,
+    gboolean bypass);
 static gboolean gst_g1_base_dec_get_config (GstG1BaseDec * g1dec,
     PPConfig * config);
 static gboolean gst_g1_base_dec_setup_pp (GstG1BaseDec * g1dec);
+static gboolean gst_g1_base_dec_config_deinterlace (GstG1BaseDec * g1dec);
 static void gst_g1_base_dec_config_rotation (GstG1BaseDec * g1dec,
     gint rotation);
 static void gst_g1_base_dec_config_brightness (GstG1BaseDec * g1dec,
@@ -128,8 +336,9 @@ static void gst_g1_base_dec_config_saturation (GstG1BaseDec * g1dec,
     gint saturation);
 static void gst_g1_base_dec_config_crop (GstG1BaseDec * g1dec,
     gint x, gint y, gint width, gint height);
-static void gst_g1_base_dec_config_mask1 (GstG1BaseDec * g1dec,
+static gboolean gst_g1_base_dec_config_mask1 (GstG1BaseDec * g1dec,
     const gchar * location, gint x, gint y, gint width, gint height);
+static void gst_g1_base_dec_load_mask1 (GstG1BaseDec * g1dec);
 
 static void
 gst_g1_base_dec_class_init (GstG1BaseDecClass * klass)
@@ -144,6 +353,7 @@ gst_g1_base_dec_class_init (GstG1BaseDecClass * klass)
 
   gobject_class->set_property = gst_g1_base_dec_set_property;
   gobject_class->get_property = gst_g1_base_dec_get_property;
+  gobject_class->finalize = gst_g1_base_dec_finalize;
 
   g_object_class_install_property (gobject_class, PROP_ROTATION,
       g_param_spec_enum ("rotation", "Rotation",
@@ -151,6 +361,14 @@ gst_g1_base_dec_class_init (GstG1BaseDecClass * klass)
           GST_G1_ENUM_ROTATION_TYPE,
           PROP_DEFAULT_ROTATION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_DEINTERLACE,
+      g_param_spec_enum ("deinterlace", "Deinterlace",
+          "Deinterlace pictures in the post processor and output them "
+          "progressive. Auto follows the stream headers.",
+          GST_G1_ENUM_DEINTERLACE_TYPE,
+          PROP_DEFAULT_DEINTERLACE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class, PROP_BRIGHTNESS,
       g_param_spec_int ("brightness",
           "Brightness",
@@ -202,6 +420,20 @@ gst_g1_base_dec_class_init (GstG1BaseDecClass * klass)
           PROP_DEFAULT_CROP_HEIGHT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_ROI_CROP,
+      g_param_spec_boolean ("roi-crop",
+          "ROI Crop",
+          "Crop each picture to the region of interest meta of its buffer, "
+          "scaling it to the output size. Takes precedence over the crop "
+          "properties and the " CROP_EVENT_NAME " events.",
+          PROP_DEFAULT_ROI_CROP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ROI_TYPE,
+      g_param_spec_string ("roi-type",
+          "ROI Type",
+          "Type of the regions of interest used by roi-crop, NULL for any",
+          PROP_DEFAULT_ROI_TYPE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
 
   g_object_class_install_property (gobject_class, PROP_MASK1_LOCATION,
       g_param_spec_string ("mask1-location",
@@ -264,13 +496,121 @@ gst_g1_base_dec_class_init (GstG1BaseDecClass * klass)
           "height of the screen ", 0, 4096,
           PROP_DEFAULT_Y, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_INPUT_RING_SIZE,
+      g_param_spec_uint ("input-ring-size",
+          "Input Ring Size",
+          "Size in bytes of a single contiguous ring buffer where compressed "
+          "input not allocated by a G1 allocator is copied to, instead of "
+          "allocating a block per frame. 0 disables the ring.",
+          0, 64 * 1024 * 1024,
+          PROP_DEFAULT_INPUT_RING_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ASYNC_DECODE,
+      g_param_spec_boolean ("async-decode",
+          "Asynchronous Decode",
+          "Run the hardware in a dedicated thread, so the next frame is "
+          "decoded while the previous picture is pushed downstream",
+          PROP_DEFAULT_ASYNC_DECODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_PP_MULTIBUFFER,
+      g_param_spec_boolean ("pp-multibuffer",
+          "Post Processor Multibuffer",
+          "Let the post processor cycle through a ring of output buffers, "
+          "sized from the stream headers, instead of reprogramming its "
+          "output for every picture",
+          PROP_DEFAULT_PP_MULTIBUFFER,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_WIDTH,
+      g_param_spec_uint ("max-width",
+          "Maximum Width",
+          "Largest output width the stream may switch to. Output buffers "
+          "are preallocated for it so resolution changes reuse them. "
+          "0 sizes them for the negotiated resolution.",
+          0, 4096,
+          PROP_DEFAULT_MAX_WIDTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_HEIGHT,
+      g_param_spec_uint ("max-height",
+          "Maximum Height",
+          "Largest output height the stream may switch to. Output buffers "
+          "are preallocated for it so resolution changes reuse them. "
+          "0 sizes them for the negotiated resolution.",
+          0, 4096,
+          PROP_DEFAULT_MAX_HEIGHT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_PRIORITY,
+      g_param_spec_int ("priority",
+          "Priority",
+          "Priority of this decoder on the G1 core shared with the other "
+          "decoders in the process. Higher priorities are served first.",
+          -100, 100,
+          PROP_DEFAULT_PRIORITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SCHEDULING,
+      g_param_spec_enum ("scheduling",
+          "Scheduling",
+          "How this decoder takes turns on the G1 core with the other "
+          "decoders of the same priority",
+          GST_G1_SCHEDULER_POLICY_TYPE,
+          PROP_DEFAULT_SCHEDULING,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_HARDWARE_TIME,
+      g_param_spec_uint64 ("hardware-time",
+          "Hardware Time",
+          "Time in nanoseconds this decoder held the G1 core since it was "
+          "opened",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_QOS,
+      g_param_spec_boolean ("qos",
+          "Quality of Service",
+          "Skip non-reference pictures and post processing of frames that "
+          "QoS reports as too late to be displayed",
+          PROP_DEFAULT_QOS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats",
+          "Statistics",
+          "Histograms of the time frames spend copying input, decoding, "
+          "post processing and pushing, along with concealed macroblocks, "
+          "skipped pictures and bytes copied since the decoder was opened",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval",
+          "Statistics Interval",
+          "Interval in milliseconds at which the statistics are posted as "
+          "g1-stats element messages. 0 disables them.",
+          0, G_MAXUINT,
+          PROP_DEFAULT_STATS_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   parent_class = g_type_class_peek_parent (klass);
 
   klass->open = NULL;
   klass->close = NULL;
   klass->decode = NULL;
+  klass->drain = NULL;
+  klass->fill_input = NULL;
 
   vdec_class->open = GST_DEBUG_FUNCPTR (gst_g1_base_dec_open);
+  vdec_class->stop = GST_DEBUG_FUNCPTR (gst_g1_base_dec_stop);
+  vdec_class->finish = GST_DEBUG_FUNCPTR (gst_g1_base_dec_finish);
+  vdec_class->drain = GST_DEBUG_FUNCPTR (gst_g1_base_dec_drain);
+  vdec_class->flush = GST_DEBUG_FUNCPTR (gst_g1_base_dec_flush);
+  vdec_class->sink_event = GST_DEBUG_FUNCPTR (gst_g1_base_dec_sink_event);
+  vdec_class->src_event = GST_DEBUG_FUNCPTR (gst_g1_base_dec_src_event);
   vdec_class->handle_frame = GST_DEBUG_FUNCPTR (gst_g1_base_dec_handle_frame);
   vdec_class->set_format = GST_DEBUG_FUNCPTR (gst_g1_base_dec_set_format);
   vdec_class->close = GST_DEBUG_FUNCPTR (gst_g1_base_dec_close);
@@ -280,8 +620,14 @@ gst_g1_base_dec_class_init (GstG1BaseDecClass * klass)
       GST_DEBUG_FUNCPTR (gst_g1_base_dec_propose_allocation);
   vdec_class->sink_query = GST_DEBUG_FUNCPTR (gst_g1_base_dec_sink_query);
 
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_g1_base_dec_request_new_pad);
+  element_class->release_pad = GST_DEBUG_FUNCPTR (gst_g1_base_dec_release_pad);
+
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&gst_g1_base_dec_src_pad_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_g1_base_dec_analytics_pad_template));
 
   GST_DEBUG_CATEGORY_INIT (g1_base_dec_debug, "g1basedec", 0,
       "Hantro G1 base decoder class");
@@ -297,9 +643,77 @@ gst_g1_base_dec_init (GstG1BaseDec * dec)
   dec->pp = NULL;
   dec->dectype = PP_PIPELINE_DISABLED;
   dec->ppconfig = (const PPConfig) { {0} };
+  g_mutex_init (&dec->pp_lock);
+  dec->pp_dirty = PP_DIRTY_ALL;
   dec->allocator = NULL;
+  dec->input_size = 0;
+  dec->max_input_size = 0;
+  dec->convert_input = FALSE;
+  dec->input_ring_size = PROP_DEFAULT_INPUT_RING_SIZE;
+  dec->input_ring = NULL;
+  dec->input_ring_offset = 0;
+
+  dec->async_decode = PROP_DEFAULT_ASYNC_DECODE;
+  dec->worker = NULL;
+  g_mutex_init (&dec->async_lock);
+  g_cond_init (&dec->async_cond);
+  g_queue_init (&dec->input_queue);
+  g_queue_init (&dec->output_queue);
+  dec->worker_frame = NULL;
+  dec->worker_stop = FALSE;
+  dec->flushing = FALSE;
+  dec->async_ret = GST_FLOW_OK;
+  dec->resize_pending = FALSE;
+  dec->resize_changed = FALSE;
+  dec->resize_drained = FALSE;
+  dec->resize_width = 0;
+  dec->resize_height = 0;
+
+  dec->output_buffer = NULL;
+  dec->pictures = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) gst_video_codec_frame_unref);
+  dec->dpb_size = 0;
+  dec->multibuff_size = 0;
+
+  dec->pp_multibuffer = PROP_DEFAULT_PP_MULTIBUFFER;
+  dec->multibuff = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      gst_buffer_unref);
+  dec->multibuff_config = (const PPOutputBuffers) { 0 };
+  dec->multibuff_pool = NULL;
+  dec->multibuff_next = 0;
+
+  dec->pp_bypass = FALSE;
+  dec->native_max = 0;
+  dec->native_outputs = 0;
+  dec->native_pictures = g_hash_table_new (g_direct_hash, g_direct_equal);
+  dec->native_flushing = FALSE;
+  g_mutex_init (&dec->native_lock);
+  g_cond_init (&dec->native_cond);
+
+  dec->qos = PROP_DEFAULT_QOS;
+  dec->pp_skipped = FALSE;
+  dec->trick_mode = FALSE;
+
+  dec->stats_interval = PROP_DEFAULT_STATS_INTERVAL;
+  gst_g1_base_dec_reset_stats (dec);
+
+  dec->analytics_pad = NULL;
+  dec->analytics_pp = NULL;
+  gst_video_info_init (&dec->analytics_info);
+  dec->analytics_pool = NULL;
+
+  dec->scheduler = NULL;
+  dec->priority = PROP_DEFAULT_PRIORITY;
+  dec->scheduling = PROP_DEFAULT_SCHEDULING;
+
+  dec->follow_input = FALSE;
+  dec->max_width = PROP_DEFAULT_MAX_WIDTH;
+  dec->max_height = PROP_DEFAULT_MAX_HEIGHT;
+  dec->output_pool = NULL;
 
   dec->rotation = PROP_DEFAULT_ROTATION;
+  dec->deinterlace = PROP_DEFAULT_DEINTERLACE;
+  dec->interlaced = FALSE;
 
   dec->brightness = PROP_DEFAULT_BRIGHTNESS;
   dec->contrast = PROP_DEFAULT_CONTRAST;
@@ -309,6 +723,18 @@ gst_g1_base_dec_init (GstG1BaseDec * dec)
   dec->crop_y = PROP_DEFAULT_CROP_Y;
   dec->crop_width = PROP_DEFAULT_CROP_WIDTH;
   dec->crop_height = PROP_DEFAULT_CROP_HEIGHT;
+  dec->out_width = 0;
+  dec->out_height = 0;
+
+  dec->roi_crop = PROP_DEFAULT_ROI_CROP;
+  dec->roi_type = PROP_DEFAULT_ROI_TYPE;
+  dec->roi_x = 0;
+  dec->roi_y = 0;
+  dec->roi_width = 0;
+  dec->roi_height = 0;
+  dec->roi_active = FALSE;
+  dec->pp_picture = 0;
+  dec->pp_interlaced = FALSE;
 
   dec->mask1_location = PROP_DEFAULT_MASK1_LOCATION;
   dec->mask1_x = PROP_DEFAULT_MASK1_X;
@@ -318,6 +744,256 @@ gst_g1_base_dec_init (GstG1BaseDec * dec)
   dec->x = PROP_DEFAULT_X;
   dec->y = PROP_DEFAULT_Y;
   dec->mask1_mem = NULL;
+
+  dec->overlay = NULL;
+  memset (dec->overlay_mem, 0, sizeof (dec->overlay_mem));
+  memset (dec->multibuff_held, 0, sizeof (dec->multibuff_held));
+  memset (dec->overlay_seqnum, 0, sizeof (dec->overlay_seqnum));
+  dec->overlay_masks = 0;
+}
+
+static void
+gst_g1_base_dec_finalize (GObject * object)
+{
+  GstG1BaseDec *dec = GST_G1_BASE_DEC (object);
+
+  g_mutex_clear (&dec->async_lock);
+  g_cond_clear (&dec->async_cond);
+  g_mutex_clear (&dec->pp_lock);
+  g_mutex_clear (&dec->native_lock);
+  g_cond_clear (&dec->native_cond);
+
+  g_hash_table_destroy (dec->native_pictures);
+  dec->native_pictures = NULL;
+
+  g_hash_table_destroy (dec->pictures);
+  dec->pictures = NULL;
+
+  g_ptr_array_free (dec->multibuff, TRUE);
+  dec->multibuff = NULL;
+
+  g_free (dec->mask1_location);
+  dec->mask1_location = NULL;
+
+  g_free (dec->roi_type);
+  dec->roi_type = NULL;
+
+  if (dec->overlay) {
+    gst_video_overlay_composition_unref (dec->overlay);
+    dec->overlay = NULL;
+  }
+
+  if (dec->analytics_pad) {
+    gst_object_unref (dec->analytics_pad);
+    dec->analytics_pad = NULL;
+  }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static GstPad *
+gst_g1_base_dec_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
+{
+  GstG1BaseDec *dec = GST_G1_BASE_DEC (element);
+  GstPad *pad;
+
+  GST_OBJECT_LOCK (dec);
+  if (dec->analytics_pad) {
+    GST_OBJECT_UNLOCK (dec);
+    GST_WARNING_OBJECT (dec, "analytics pad already requested");
+    return NULL;
+  }
+
+  pad = gst_pad_new_from_template (templ, "analytics");
+  dec->analytics_pad = gst_object_ref (pad);
+  GST_OBJECT_UNLOCK (dec);
+
+  /* Caps are negotiated from the streaming thread once it is linked */
+  gst_element_add_pad (element, pad);
+
+  GST_INFO_OBJECT (dec, "analytics pad requested");
+
+  return pad;
+}
+
+static void
+gst_g1_base_dec_release_pad (GstElement * element, GstPad * pad)
+{
+  GstG1BaseDec *dec = GST_G1_BASE_DEC (element);
+
+  GST_OBJECT_LOCK (dec);
+  if (pad != dec->analytics_pad) {
+    GST_OBJECT_UNLOCK (dec);
+    return;
+  }
+  dec->analytics_pad = NULL;
+  GST_OBJECT_UNLOCK (dec);
+
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+  gst_object_unref (pad);
+
+  GST_INFO_OBJECT (dec, "analytics pad released");
+}
+
+/* Returns a reference to the analytics pad, if requested */
+static GstPad *
+gst_g1_base_dec_get_analytics_pad (GstG1BaseDec * dec)
+{
+  GstPad *pad = NULL;
+
+  GST_OBJECT_LOCK (dec);
+  if (dec->analytics_pad)
+    pad = gst_object_ref (dec->analytics_pad);
+  GST_OBJECT_UNLOCK (dec);
+
+  return pad;
+}
+
+static void
+gst_g1_base_dec_reset_analytics (GstG1BaseDec * dec)
+{
+  GstBufferPool *pool;
+
+  GST_OBJECT_LOCK (dec);
+  pool = dec->analytics_pool;
+  dec->analytics_pool = NULL;
+  gst_video_info_init (&dec->analytics_info);
+  GST_OBJECT_UNLOCK (dec);
+
+  if (pool) {
+    gst_buffer_pool_set_active (pool, FALSE);
+    gst_object_unref (pool);
+  }
+}
+
+/* Negotiates the analytics pad when it is linked or downstream asks for
+   it. Must be called from the streaming thread, so caps and segment are
+   in order with the events forwarded from upstream */
+static void
+gst_g1_base_dec_negotiate_analytics (GstG1BaseDec * dec)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstVideoCodecState *state = NULL;
+  GstStructure *structure, *config;
+  GstBufferPool *pool, *old;
+  GstCaps *caps = NULL, *templ;
+  GstEvent *event;
+  GstVideoInfo vinfo;
+  GstPad *pad;
+  gchar *stream_id;
+
+  pad = gst_g1_base_dec_get_analytics_pad (dec);
+  if (!pad)
+    return;
+
+  if (!gst_pad_is_linked (pad))
+    goto exit;
+
+  if (!gst_pad_check_reconfigure (pad) && dec->analytics_pool)
+    goto exit;
+
+  state = gst_video_decoder_get_output_state (bdec);
+  if (!state)
+    goto exit;
+
+  templ = gst_pad_get_pad_template_caps (pad);
+  caps = gst_pad_peer_query_caps (pad, templ);
+  gst_caps_unref (templ);
+
+  if (gst_caps_is_empty (caps)) {
+    GST_WARNING_OBJECT (dec, "analytics pad peer accepts no output format");
+    goto exit;
+  }
+
+  /* Sizes downstream leaves open follow the main output */
+  caps = gst_caps_truncate (caps);
+  caps = gst_caps_make_writable (caps);
+  structure = gst_caps_get_structure (caps, 0);
+  gst_structure_fixate_field_nearest_int (structure, "width",
+      GST_VIDEO_INFO_WIDTH (&state->info));
+  gst_structure_fixate_field_nearest_int (structure, "height",
+      GST_VIDEO_INFO_HEIGHT (&state->info));
+  gst_structure_fixate_field_nearest_fraction (structure, "framerate",
+      GST_VIDEO_INFO_FPS_N (&state->info), GST_VIDEO_INFO_FPS_D (&state->info));
+  caps = gst_caps_fixate (caps);
+
+  if (!gst_video_info_from_caps (&vinfo, caps)) {
+    GST_ERROR_OBJECT (dec, "unable to parse analytics caps %" GST_PTR_FORMAT,
+        caps);
+    goto exit;
+  }
+
+  /* The post processor writes to physically contiguous memory only */
+  pool = gst_g1_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps,
+      GST_VIDEO_INFO_SIZE (&vinfo), ANALYTICS_POOL_MIN_BUFFERS, 0);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_VIDEO_META);
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE)) {
+    GST_ERROR_OBJECT (dec, "unable to set up analytics buffer pool");
+    gst_object_unref (pool);
+    goto exit;
+  }
+
+  /* The pad may have been requested after the stream started */
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_STREAM_START, 0);
+  if (event) {
+    gst_event_unref (event);
+  } else {
+    stream_id = gst_pad_create_stream_id (pad, GST_ELEMENT (dec),
+        "analytics");
+    gst_pad_push_event (pad, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+  }
+
+  GST_INFO_OBJECT (dec, "analytics caps %" GST_PTR_FORMAT, caps);
+  gst_pad_push_event (pad, gst_event_new_caps (caps));
+  gst_pad_push_event (pad, gst_event_new_segment (&bdec->input_segment));
+
+  GST_OBJECT_LOCK (dec);
+  old = dec->analytics_pool;
+  dec->analytics_pool = pool;
+  dec->analytics_info = vinfo;
+  GST_OBJECT_UNLOCK (dec);
+
+  if (old) {
+    gst_buffer_pool_set_active (old, FALSE);
+    gst_object_unref (old);
+  }
+
+exit:
+  {
+    if (caps)
+      gst_caps_unref (caps);
+    if (state)
+      gst_video_codec_state_unref (state);
+    gst_object_unref (pad);
+  }
+}
+
+static void
+gst_g1_base_dec_push_analytics (GstG1BaseDec * dec, GstBuffer * buffer)
+{
+  GstFlowReturn ret;
+  GstPad *pad;
+
+  pad = gst_g1_base_dec_get_analytics_pad (dec);
+  if (!pad) {
+    gst_buffer_unref (buffer);
+    return;
+  }
+
+  /* The main output carries on whatever happens to this one */
+  ret = gst_pad_push (pad, buffer);
+  if (GST_FLOW_OK != ret && GST_FLOW_NOT_LINKED != ret)
+    GST_DEBUG_OBJECT (dec, "analytics pad returned %s",
+        gst_flow_get_name (ret));
+
+  gst_object_unref (pad);
 }
 
 static gboolean
@@ -337,6 +1013,17 @@ gst_g1_base_dec_open (GstVideoDecoder * decoder)
   /* Any error here is a programming error */
   g_return_val_if_fail (g1dec->allocator, FALSE);
 
+  GST_OBJECT_LOCK (g1dec);
+  gst_g1_base_dec_reset_stats (g1dec);
+  GST_OBJECT_UNLOCK (g1dec);
+
+  /* Hardware jobs go through the scheduler shared by all instances */
+  g_mutex_lock (&g1dec->pp_lock);
+  g1dec->scheduler = gst_g1_scheduler_register (GST_OBJECT (g1dec));
+  gst_g1_scheduler_configure (g1dec->scheduler, g1dec->scheduling,
+      g1dec->priority);
+  g_mutex_unlock (&g1dec->pp_lock);
+
   ppret = PPInit (&g1dec->pp);
   if (GST_G1_PP_FAILED (ppret)) {
     GST_ERROR_OBJECT (g1dec, "Failed to open post processor, %s",
@@ -360,8 +1047,13 @@ gst_g1_base_dec_open (GstVideoDecoder * decoder)
     ret = FALSE;
     goto exit;
   }
+  g1dec->pp_bypass = FALSE;
 
-  if (!gst_g1_base_dec_setup_pp (g1dec)) {
+  g_mutex_lock (&g1dec->pp_lock);
+  ret = gst_g1_base_dec_setup_pp (g1dec);
+  g_mutex_unlock (&g1dec->pp_lock);
+  gst_g1_base_dec_load_mask1 (g1dec);
+  if (!ret) {
     GST_ERROR_OBJECT (g1dec, "Failed to set pp initial configuration");
     ret = FALSE;
     goto exit;
@@ -376,11 +1068,37 @@ exit:
   }
 }
 
+static guint
+gst_g1_base_dec_input_size (GstG1BaseDec * dec, GstCaps * caps)
+{
+  GstStructure *structure;
+  gint width, height;
+  guint size;
+
+  /* A compressed picture is not expected to exceed half of its raw
+     4:2:0 size */
+  structure = gst_caps_get_structure (caps, 0);
+  if (gst_structure_get_int (structure, "width", &width) &&
+      gst_structure_get_int (structure, "height", &height))
+    size = width * height * 3 / 4;
+  else
+    size = INPUT_POOL_DEFAULT_SIZE;
+
+  size = MAX (size, dec->max_input_size);
+
+  return GST_ROUND_UP_N (size, 4096);
+}
+
 static gboolean
 gst_g1_base_dec_propose_allocation (GstVideoDecoder * decoder, GstQuery * query)
 {
   GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
   GstAllocationParams params;
+  GstBufferPool *pool;
+  GstStructure *config;
+  GstCaps *caps;
+  gboolean need_pool;
+  guint size;
 
   params = (const GstAllocationParams) { 0 };
   params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
@@ -390,6 +1108,29 @@ gst_g1_base_dec_propose_allocation (GstVideoDecoder * decoder, GstQuery * query)
   /* By now we should have the allocator already */
   g_return_val_if_fail (g1dec->allocator, FALSE);
 
+  /* Let upstream write the bitstream straight into contiguous memory */
+  gst_query_parse_allocation (query, &caps, &need_pool);
+  if (caps && need_pool) {
+    size = gst_g1_base_dec_input_size (g1dec, caps);
+
+    pool = gst_g1_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, size,
+        INPUT_POOL_MIN_BUFFERS, 0);
+    gst_buffer_pool_config_set_allocator (config, g1dec->allocator, &params);
+
+    if (gst_buffer_pool_set_config (pool, config)) {
+      GST_INFO_OBJECT (g1dec, "proposing input pool of %d bytes buffers",
+          size);
+      gst_query_add_allocation_pool (query, pool, size,
+          INPUT_POOL_MIN_BUFFERS, 0);
+      g1dec->input_size = size;
+    } else {
+      GST_WARNING_OBJECT (g1dec, "unable to configure input pool");
+    }
+    gst_object_unref (pool);
+  }
+
   gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
   gst_query_add_allocation_param (query, g1dec->allocator, &params);
 
@@ -397,13 +1138,70 @@ gst_g1_base_dec_propose_allocation (GstVideoDecoder * decoder, GstQuery * query)
       query);
 }
 
+static guint
+gst_g1_base_dec_output_size (GstVideoInfo * vinfo)
+{
+  GstVideoInfo aligned = *vinfo;
+
+  /* The post processor writes 16 pixel aligned images */
+  gst_format_g1_align (&aligned);
+  return GST_VIDEO_INFO_SIZE (&aligned);
+}
+
+/* Output buffers held by the decoder at any time, on top of the ones
+   downstream keeps */
+static guint
+gst_g1_base_dec_output_buffers (GstG1BaseDec * dec)
+{
+  guint buffers;
+
+  /* The post processor writes one picture at a time, unless it cycles
+     through a ring of them */
+  if (dec->pp_multibuffer && dec->multibuff_size > 1 && !dec->pp_bypass)
+    buffers = MIN (dec->multibuff_size, PP_MAX_MULTIBUFFER);
+  else
+    buffers = 1;
+
+  /* Pictures queued by the worker wait for the streaming thread */
+  if (dec->async_decode)
+    buffers += ASYNC_QUEUE_SIZE;
+
+  return buffers;
+}
+
+/* Checks whether a pool holds enough buffers of at least size bytes, and
+   returns their actual size */
+static gboolean
+gst_g1_base_dec_pool_fits (GstBufferPool * pool, guint * size, guint min)
+{
+  GstStructure *config;
+  guint psize, pmin, pmax;
+  gboolean ret;
+
+  config = gst_buffer_pool_get_config (pool);
+  ret = gst_buffer_pool_config_get_params (config, NULL, &psize, &pmin, &pmax)
+      && psize >= *size && pmin >= min;
+  gst_structure_free (config);
+
+  if (ret)
+    *size = psize;
+
+  return ret;
+}
+
 static gboolean
 gst_g1_base_dec_decide_allocation (GstVideoDecoder * decoder, GstQuery * query)
 {
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
   guint nparams;
   gint i;
   GstAllocationParams params;
   GstAllocator *allocator;
+  GstBufferPool *pool;
+  GstStructure *config;
+  GstVideoInfo vinfo;
+  GstCaps *caps;
+  guint size, min, max;
 
   nparams = gst_query_get_n_allocation_params (query);
   for (i = 0; i < nparams; ++i) {
@@ -421,11 +1219,132 @@ gst_g1_base_dec_decide_allocation (GstVideoDecoder * decoder, GstQuery * query)
   nparams = gst_query_get_n_allocation_params (query);
   if (!nparams) {
     GST_INFO_OBJECT (decoder, "using fallback " GST_ALLOCATOR_DWL " allocator");
-    gst_g1_base_dec_propose_allocation (decoder, query);
+    params = (const GstAllocationParams) { 0 };
+    params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
+    gst_query_add_allocation_param (query, g1dec->allocator, &params);
   }
 
-  return GST_VIDEO_DECODER_CLASS (parent_class)->decide_allocation (decoder,
-      query);
+  /* Size the pool for what downstream keeps plus what we keep. When a
+     DPB is drained its pictures are pushed back to back, allow that
+     many extra buffers before blocking. A pool downstream bounds below
+     that would stall the decoder, leave it for one of our own. */
+  if (gst_query_get_n_allocation_pools (query)) {
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+    min += gst_g1_base_dec_output_buffers (g1dec);
+    if (max && min > max) {
+      GST_WARNING_OBJECT (decoder, "downstream allows %d output buffers, "
+          "%d are needed, using our own pool", max, min);
+      if (pool)
+        gst_object_unref (pool);
+      pool = NULL;
+      max = 0;
+    }
+    if (!max && g1dec->dpb_size)
+      max = min + g1dec->dpb_size;
+    GST_DEBUG_OBJECT (decoder, "requesting %d to %d output buffers", min, max);
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+    if (pool)
+      gst_object_unref (pool);
+  }
+
+  if (!GST_VIDEO_DECODER_CLASS (parent_class)->decide_allocation (decoder,
+          query))
+    return FALSE;
+
+  gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+
+  /* KMS buffers are scanned out directly, let the PP write into them */
+  if (pool && gst_buffer_pool_has_option (pool,
+          GST_BUFFER_POOL_OPTION_KMS_BUFFER)) {
+    GST_INFO_OBJECT (decoder, "using downstream KMS buffer pool");
+    gst_object_unref (pool);
+    return TRUE;
+  }
+
+  if (pool)
+    gst_object_unref (pool);
+
+  gst_query_parse_allocation (query, &caps, NULL);
+  if (!caps || !gst_video_info_from_caps (&vinfo, caps)) {
+    GST_ERROR_OBJECT (decoder, "unable to parse allocation caps");
+    return FALSE;
+  }
+
+  /* Our own pool, sized the same way if the bound doesn't fit it */
+  size = gst_g1_base_dec_output_size (&vinfo);
+  min = MAX (min, OUTPUT_POOL_MIN_BUFFERS);
+  if (max && min > max) {
+    GST_DEBUG_OBJECT (decoder, "%d output buffers don't fit a maximum of %d",
+        min, max);
+    max = g1dec->dpb_size ? min + g1dec->dpb_size : 0;
+  }
+
+  /* After a resolution change keep the pool as it is if its buffers are
+     large enough. Downstream still holds some of them, so it can't be
+     configured again, each buffer gets the layout of the new caps in its
+     video meta when it is taken out instead. */
+  if (g1dec->output_pool &&
+      gst_g1_base_dec_pool_fits (g1dec->output_pool, &size, min)) {
+    GST_INFO_OBJECT (decoder, "reusing G1 buffer pool for %dx%d",
+        GST_VIDEO_INFO_WIDTH (&vinfo), GST_VIDEO_INFO_HEIGHT (&vinfo));
+    gst_query_set_nth_allocation_pool (query, 0, g1dec->output_pool, size,
+        min, max);
+    return TRUE;
+  }
+
+  /* Leave room for the largest resolution the stream may switch to */
+  if (g1dec->max_width || g1dec->max_height) {
+    GstVideoInfo maxinfo;
+
+    gst_video_info_set_format (&maxinfo, GST_VIDEO_INFO_FORMAT (&vinfo),
+        MAX (GST_VIDEO_INFO_WIDTH (&vinfo), g1dec->max_width),
+        MAX (GST_VIDEO_INFO_HEIGHT (&vinfo), g1dec->max_height));
+    size = MAX (size, gst_g1_base_dec_output_size (&maxinfo));
+  }
+
+  pool = gst_g1_buffer_pool_new ();
+
+  params = (const GstAllocationParams) { 0 };
+  params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+  gst_buffer_pool_config_set_allocator (config, g1dec->allocator, &params);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_ERROR_OBJECT (decoder, "unable to configure G1 buffer pool");
+    gst_object_unref (pool);
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (decoder, "using G1 buffer pool with %d to %d buffers of "
+      "%d bytes", min, max, size);
+
+  gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+  gst_object_replace ((GstObject **) & g1dec->output_pool, (GstObject *) pool);
+  gst_object_unref (pool);
+
+  return TRUE;
+}
+
+/* Writes an access unit for the hardware, or returns the size it takes
+   if dest is NULL */
+static gsize
+gst_g1_base_dec_fill_input (GstG1BaseDec * dec, guint8 * dest,
+    GstMapInfo * src)
+{
+  GstG1BaseDecClass *g1decclass;
+
+  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (dec));
+
+  if (dec->convert_input && g1decclass->fill_input)
+    return g1decclass->fill_input (dec, dest, src->data, src->size);
+
+  if (dest)
+    memcpy (dest, src->data, src->size);
+
+  return src->size;
 }
 
 static gboolean
@@ -436,6 +1355,7 @@ gst_g1_base_dec_copy_memory (GstG1BaseDec * dec, GstMemory ** dst,
   GstMapInfo srcinfo;
   GstMapInfo dstinfo;
   const gchar *errormsg;
+  gsize size;
 
   g_return_val_if_fail (src, FALSE);
   g_return_val_if_fail (dec, FALSE);
@@ -445,10 +1365,20 @@ gst_g1_base_dec_copy_memory (GstG1BaseDec * dec, GstMemory ** dst,
   0};
   params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
 
-  *dst = gst_allocator_alloc (dec->allocator, src->size, &params);
-
   if (!gst_memory_map (src, &srcinfo, GST_MAP_READ)) {
-    errormsg = "unable to map src memory";
+    GST_ERROR_OBJECT (dec, "unable to map src memory");
+    return FALSE;
+  }
+
+  size = gst_g1_base_dec_fill_input (dec, NULL, &srcinfo);
+  if (!size) {
+    errormsg = "malformed access unit";
+    goto srcerror;
+  }
+
+  *dst = gst_allocator_alloc (dec->allocator, size, &params);
+  if (!*dst) {
+    errormsg = "unable to allocate contiguous memory";
     goto srcerror;
   }
 
@@ -459,7 +1389,7 @@ gst_g1_base_dec_copy_memory (GstG1BaseDec * dec, GstMemory ** dst,
 
   GST_CAT_LOG (GST_CAT_PERFORMANCE,
       "the G1 decoders only accept physically contiguous memory, copying data...");
-  memcpy (dstinfo.data, srcinfo.data, dstinfo.size);
+  gst_g1_base_dec_fill_input (dec, dstinfo.data, &srcinfo);
 
   gst_memory_unmap (src, &srcinfo);
   gst_memory_unmap (*dst, &dstinfo);
@@ -467,46 +1397,189 @@ gst_g1_base_dec_copy_memory (GstG1BaseDec * dec, GstMemory ** dst,
 
 dsterror:
   {
-    gst_memory_unmap (src, &srcinfo);
+    gst_allocator_free (dec->allocator, *dst);
+    *dst = NULL;
   }
 srcerror:
   {
+    gst_memory_unmap (src, &srcinfo);
     GST_ERROR_OBJECT (dec, "%s", errormsg);
-    gst_allocator_free (dec->allocator, *dst);
-    *dst = NULL;
     return FALSE;
   }
 }
 
-static GstFlowReturn
-gst_g1_base_dec_stream_header (GstVideoDecoder * decoder)
+static gboolean
+gst_g1_base_dec_frame_in_ring (GstG1BaseDec * dec, GstVideoCodecFrame * frame,
+    gsize offset, gsize size)
 {
-  GstG1BaseDec *g1dec;
-  GstG1BaseDecClass *g1decclass;
-  GstMemory *mem, *g1mem;
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstCaps *sinkcaps;
-  const gchar *mimetype;
+  GstMemory *mem;
 
-  const GstStructure *structure;
-  GstBuffer *streamheader = NULL;
-  gchar *desc = NULL;
-  const GValue *value = NULL;
+  if (!frame || !gst_buffer_n_memory (frame->input_buffer))
+    return FALSE;
 
-  g1dec = GST_G1_BASE_DEC (decoder);
-  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (g1dec));
+  mem = gst_buffer_peek_memory (frame->input_buffer, 0);
+  if (mem->parent != dec->input_ring)
+    return FALSE;
 
-  sinkcaps = gst_pad_get_allowed_caps (GST_VIDEO_DECODER_SINK_PAD (decoder));
-  sinkcaps = gst_caps_fixate (sinkcaps);
-  desc = gst_caps_to_string (sinkcaps);
+  return offset < mem->offset + mem->size && mem->offset < offset + size;
+}
 
-  structure = gst_caps_get_structure (sinkcaps, 0);
-  mimetype = gst_structure_get_name (structure);
-  if (!strcmp (mimetype, "video/mpeg")) {
-    if (value = gst_structure_get_value (structure, "codec_data")) {
-      streamheader = gst_value_get_buffer (value);
-    }
-  } else if (!strcmp (mimetype, "video/x-vp8")) {
+static gboolean
+gst_g1_base_dec_ring_in_use (GstG1BaseDec * dec, gsize offset, gsize size)
+{
+  GList *l;
+  gboolean ret = FALSE;
+#if GST_CHECK_VERSION(1,2,0)
+  GList *frames;
+
+  /* Every frame the decoder still tracks may hold a window into the
+     ring, whether it is queued to the worker or waiting to be output */
+  frames = gst_video_decoder_get_frames (GST_VIDEO_DECODER (dec));
+  for (l = frames; l && !ret; l = l->next)
+    ret = gst_g1_base_dec_frame_in_ring (dec, l->data, offset, size);
+  g_list_free_full (frames, (GDestroyNotify) gst_video_codec_frame_unref);
+#else
+  /* Without access to the pending frames, only the ones the hardware
+     hasn't consumed yet can be checked */
+  g_mutex_lock (&dec->async_lock);
+  ret = gst_g1_base_dec_frame_in_ring (dec, dec->worker_frame, offset, size);
+  for (l = dec->input_queue.head; l && !ret; l = l->next)
+    ret = gst_g1_base_dec_frame_in_ring (dec, l->data, offset, size);
+  g_mutex_unlock (&dec->async_lock);
+#endif
+
+  return ret;
+}
+
+static void
+gst_g1_base_dec_free_ring (GstG1BaseDec * dec)
+{
+  /* Frames still holding windows into the ring keep it alive */
+  if (dec->input_ring) {
+    gst_memory_unmap (dec->input_ring, &dec->input_ring_map);
+    gst_memory_unref (dec->input_ring);
+    dec->input_ring = NULL;
+  }
+  dec->input_ring_offset = 0;
+}
+
+static gboolean
+gst_g1_base_dec_ring_memory (GstG1BaseDec * dec, GstMemory ** dst,
+    GstMemory * src)
+{
+  GstAllocationParams params;
+  GstMapInfo srcinfo;
+  guint ring_size;
+  gsize offset;
+  gsize size;
+
+  g_return_val_if_fail (src, FALSE);
+  g_return_val_if_fail (dec, FALSE);
+  g_return_val_if_fail (dec->allocator, FALSE);
+
+  GST_OBJECT_LOCK (dec);
+  ring_size = dec->input_ring_size;
+  GST_OBJECT_UNLOCK (dec);
+
+  /* The ring size changed, start over with a new block */
+  if (dec->input_ring && dec->input_ring->size != ring_size)
+    gst_g1_base_dec_free_ring (dec);
+
+  if (!gst_memory_map (src, &srcinfo, GST_MAP_READ)) {
+    GST_ERROR_OBJECT (dec, "unable to map src memory");
+    return FALSE;
+  }
+
+  size = gst_g1_base_dec_fill_input (dec, NULL, &srcinfo);
+  if (!size || size > ring_size) {
+    GST_CAT_DEBUG (GST_CAT_PERFORMANCE, "access unit of %" G_GSIZE_FORMAT
+        " bytes doesn't fit in the input ring", size);
+    goto error;
+  }
+
+  if (!dec->input_ring) {
+    params = (GstAllocationParams) {
+    0};
+    params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
+
+    dec->input_ring = gst_allocator_alloc (dec->allocator, ring_size, &params);
+    if (!dec->input_ring) {
+      GST_ERROR_OBJECT (dec, "unable to allocate input ring of %d bytes",
+          ring_size);
+      goto error;
+    }
+
+    /* Map the ring once before sharing any window of it, the windows
+       lock it shared and a writable map couldn't be taken afterwards */
+    if (!gst_memory_map (dec->input_ring, &dec->input_ring_map,
+            GST_MAP_WRITE)) {
+      GST_ERROR_OBJECT (dec, "unable to map the input ring");
+      gst_memory_unref (dec->input_ring);
+      dec->input_ring = NULL;
+      goto error;
+    }
+    dec->input_ring_offset = 0;
+    GST_INFO_OBJECT (dec, "allocated input ring of %d bytes at 0x%08x",
+        ring_size, gst_g1_allocator_get_physical (dec->input_ring));
+  }
+
+  /* Access units must be contiguous for the hardware, wrap around
+     if this one doesn't fit in the tail of the ring */
+  offset = GST_ROUND_UP_N (dec->input_ring_offset, INPUT_RING_ALIGN);
+  if (offset + size > ring_size)
+    offset = 0;
+
+  /* Never overwrite an access unit a pending frame still refers to */
+  if (gst_g1_base_dec_ring_in_use (dec, offset, size)) {
+    GST_CAT_DEBUG (GST_CAT_PERFORMANCE, "input ring is full");
+    goto error;
+  }
+
+  gst_g1_base_dec_fill_input (dec, dec->input_ring_map.data + offset,
+      &srcinfo);
+  gst_memory_unmap (src, &srcinfo);
+
+  *dst = gst_memory_share (dec->input_ring, offset, size);
+  dec->input_ring_offset = offset + size;
+
+  return TRUE;
+
+error:
+  {
+    gst_memory_unmap (src, &srcinfo);
+    return FALSE;
+  }
+}
+
+static GstFlowReturn
+gst_g1_base_dec_stream_header (GstVideoDecoder * decoder)
+{
+  GstG1BaseDec *g1dec;
+  GstG1BaseDecClass *g1decclass;
+  GstMemory *mem, *g1mem;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstCaps *sinkcaps;
+  const gchar *mimetype;
+
+  const GstStructure *structure;
+  GstBuffer *streamheader = NULL;
+  gchar *desc = NULL;
+  const GValue *value = NULL;
+
+  g1dec = GST_G1_BASE_DEC (decoder);
+  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (g1dec));
+
+  sinkcaps = gst_pad_get_allowed_caps (GST_VIDEO_DECODER_SINK_PAD (decoder));
+  sinkcaps = gst_caps_fixate (sinkcaps);
+  desc = gst_caps_to_string (sinkcaps);
+
+  structure = gst_caps_get_structure (sinkcaps, 0);
+  mimetype = gst_structure_get_name (structure);
+  if (!strcmp (mimetype, "video/mpeg")) {
+    if (value = gst_structure_get_value (structure, "codec_data")) {
+      streamheader = gst_value_get_buffer (value);
+    }
+  } else if (!strcmp (mimetype, "video/x-vp8")) {
     if ((value = gst_structure_get_value (structure, "streamheader"))) {
       streamheader = gst_value_get_buffer (value);
     }
@@ -536,6 +1609,115 @@ exit:
   return ret;
 }
 
+static void
+gst_g1_base_dec_free_frame_data (gpointer data)
+{
+  GstG1BaseDecFrameData *fdata = data;
+
+  if (fdata->overlay)
+    gst_video_overlay_composition_unref (fdata->overlay);
+  g_slice_free (GstG1BaseDecFrameData, fdata);
+}
+
+/* Whether the picture of frame a is output before the one of frame b,
+   by presentation time if both have one or else in decoding order */
+static gboolean
+gst_g1_base_dec_frame_before (GstVideoCodecFrame * a, GstVideoCodecFrame * b)
+{
+  if (GST_CLOCK_TIME_IS_VALID (a->pts) && GST_CLOCK_TIME_IS_VALID (b->pts))
+    return a->pts < b->pts;
+
+  return a->system_frame_number < b->system_frame_number;
+}
+
+/* Finds the frame whose picture the post processor writes next: the
+   first in display order among the pictures decoded but not output yet
+   and the frame being decoded, if any. The codec doesn't tell until the
+   picture comes out, by then it is post processed already. */
+static GstVideoCodecFrame *
+gst_g1_base_dec_next_frame (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GstVideoCodecFrame *next = frame;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, dec->pictures);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    if (!next || gst_g1_base_dec_frame_before (value, next))
+      next = value;
+  }
+
+  return next;
+}
+
+/* Finds the region of interest the frame is cropped to, if any */
+static gboolean
+gst_g1_base_dec_frame_roi (GstG1BaseDec * dec, GstVideoCodecFrame * frame,
+    GstG1BaseDecCrop * crop)
+{
+#if GST_CHECK_VERSION(1,2,0)
+  GstVideoRegionOfInterestMeta *meta;
+  gpointer state = NULL;
+  GstMeta *m;
+  GQuark type;
+
+  if (!dec->roi_crop)
+    return FALSE;
+
+  type = dec->roi_type ? g_quark_from_string (dec->roi_type) : 0;
+
+  while ((m = gst_buffer_iterate_meta (frame->input_buffer, &state))) {
+    if (m->info->api != GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE)
+      continue;
+
+    meta = (GstVideoRegionOfInterestMeta *) m;
+    if (type && meta->roi_type != type)
+      continue;
+
+    crop->x = meta->x;
+    crop->y = meta->y;
+    crop->width = meta->w;
+    crop->height = meta->h;
+    return crop->width && crop->height;
+  }
+#endif
+
+  return FALSE;
+}
+
+/* Attaches the crop window and overlays to the frame, so they follow
+   it to whichever thread decodes it. The region of interest and overlay
+   composition metas of the frame win over the last crop and overlay
+   events */
+static void
+gst_g1_base_dec_frame_data (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GstVideoOverlayCompositionMeta *meta;
+  GstG1BaseDecFrameData data = { 0 };
+
+  g_mutex_lock (&dec->pp_lock);
+  data.cropped = gst_g1_base_dec_frame_roi (dec, frame, &data.crop);
+  if (!data.cropped && dec->roi_width) {
+    data.crop.x = dec->roi_x;
+    data.crop.y = dec->roi_y;
+    data.crop.width = dec->roi_width;
+    data.crop.height = dec->roi_height;
+    data.cropped = TRUE;
+  }
+
+  meta = gst_video_buffer_get_overlay_composition_meta (frame->input_buffer);
+  if (meta && gst_video_overlay_composition_n_rectangles (meta->overlay))
+    data.overlay = gst_video_overlay_composition_ref (meta->overlay);
+  else if (dec->overlay)
+    data.overlay = gst_video_overlay_composition_ref (dec->overlay);
+  g_mutex_unlock (&dec->pp_lock);
+
+  if (data.cropped || data.overlay)
+    gst_video_codec_frame_set_user_data (frame,
+        g_slice_dup (GstG1BaseDecFrameData, &data),
+        gst_g1_base_dec_free_frame_data);
+}
+
 static GstFlowReturn
 gst_g1_base_dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -545,6 +1727,7 @@ gst_g1_base_dec_handle_frame (GstVideoDecoder * decoder,
   GstMemory *mem, *g1mem;
   GstFlowReturn ret;
   GstClockTime start, end;
+  gsize size;
 
   g1dec = GST_G1_BASE_DEC (decoder);
   g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (g1dec));
@@ -553,25 +1736,75 @@ gst_g1_base_dec_handle_frame (GstVideoDecoder * decoder,
 
   start = gst_util_get_timestamp ();
 
+  g1dec->trick_mode =
+      0 != (decoder->input_segment.flags & SEGMENT_FLAGS_TRICKMODE);
+
+  /* Only key frames are displayed, don't even copy the others */
+  if ((decoder->input_segment.flags & SEGMENT_FLAG_KEY_UNITS) &&
+      !GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame)) {
+    GST_LOG_OBJECT (g1dec, "key unit trick mode, dropping frame %d",
+        frame->system_frame_number);
+    gst_g1_base_dec_count (g1dec, GST_G1_BASE_DEC_SKIPPED_PICTURES, 1);
+    ret = GST_FLOW_OK;
+    goto exit;
+  }
+
+  gst_g1_base_dec_negotiate_analytics (g1dec);
+  gst_g1_base_dec_frame_data (g1dec, frame);
+
   mem = gst_buffer_get_all_memory (frame->input_buffer);
 
-  if (!GST_IS_G1_ALLOCATOR (mem->allocator)) {
-    if (!gst_g1_base_dec_copy_memory (g1dec, &g1mem, mem)) {
+  size = gst_buffer_get_size (frame->input_buffer);
+  if (size > g1dec->max_input_size)
+    g1dec->max_input_size = size;
+
+  if (!GST_IS_G1_ALLOCATOR (mem->allocator) || g1dec->convert_input) {
+    /* Upstream can't use our input pool buffers if they are too small,
+       ask it to renegotiate with the largest access unit seen */
+    if (g1dec->input_size && size > g1dec->input_size) {
+      GST_INFO_OBJECT (g1dec, "access unit of %d bytes exceeds input pool "
+          "buffers of %d bytes, requesting reconfiguration", size,
+          g1dec->input_size);
+      g1dec->input_size = 0;
+      gst_pad_push_event (GST_VIDEO_DECODER_SINK_PAD (decoder),
+          gst_event_new_reconfigure ());
+    }
+
+    if (g1dec->input_ring_size
+        && gst_g1_base_dec_ring_memory (g1dec, &g1mem, mem)) {
+      GST_LOG_OBJECT (g1dec, "copied %d bytes to the input ring", size);
+    } else if (!gst_g1_base_dec_copy_memory (g1dec, &g1mem, mem)) {
       GST_ERROR_OBJECT (g1dec, "%s",
           "unable to copy input buffer to contiguous memory");
+      gst_memory_unref (mem);
       ret = GST_FLOW_NOT_SUPPORTED;
       goto exit;
     }
-    gst_memory_unref (mem);
     gst_buffer_replace_all_memory (frame->input_buffer, g1mem);
+
+    gst_g1_base_dec_record (g1dec, GST_G1_BASE_DEC_STAGE_COPY,
+        gst_util_get_timestamp () - start);
+    gst_g1_base_dec_count (g1dec, GST_G1_BASE_DEC_BYTES_COPIED, size);
   }
+  /* Don't keep an extra reference, pooled input buffers must be writable
+     to be recycled */
+  gst_memory_unref (mem);
+
+  /* The worker thread takes over the frame */
+  if (g1dec->async_decode)
+    return gst_g1_base_dec_async_decode (g1dec, frame);
+
+  gst_g1_base_dec_native_wait (g1dec, FALSE);
 
   ret = g1decclass->decode (g1dec, frame);
   end = gst_util_get_timestamp ();
   GST_CAT_DEBUG (GST_CAT_PERFORMANCE, "Processed buffer in %" GST_TIME_FORMAT,
       GST_TIME_ARGS (end - start));
 
-  goto exit;
+  if (gst_g1_base_dec_frame_done (g1dec, frame))
+    gst_g1_base_dec_release_frame (g1dec, frame);
+
+  return ret;
 
 exit:
   {
@@ -580,231 +1813,2295 @@ exit:
   }
 }
 
+/* Called once the hardware is done with a frame. Returns TRUE if the
+   frame still has to be released with gst_g1_base_dec_release_frame */
 static gboolean
-gst_g1_base_dec_set_format (GstVideoDecoder * decoder,
-    GstVideoCodecState * state)
+gst_g1_base_dec_frame_done (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
 {
-  GstG1BaseDec *dec = GST_G1_BASE_DEC (decoder);
-  GstCaps *caps;
-  GstVideoInfo vinfo;
-  gboolean ret;
-  gchar *desc = NULL;
+  /* Don't hold an output buffer in between frames */
+  gst_buffer_replace (&dec->output_buffer, NULL);
+  dec->pp_skipped = FALSE;
 
-  if (dec->dectype != PP_PIPELINED_DEC_TYPE_H264)
-    gst_g1_base_dec_stream_header (decoder);
+  gst_g1_base_dec_frame_stats (dec);
 
-  caps = gst_pad_get_allowed_caps (GST_VIDEO_DECODER_SRC_PAD (decoder));
-  caps = gst_caps_fixate (caps);
-  desc = gst_caps_to_string (caps);
+  /* Its picture is output later on, the picture table keeps it */
+  if (g_hash_table_contains (dec->pictures,
+          GUINT_TO_POINTER (frame->system_frame_number))) {
+    gst_video_codec_frame_unref (frame);
+    return FALSE;
+  }
 
-  GST_DEBUG_OBJECT (dec, "Parsed %s from downstream", desc);
+  return TRUE;
+}
 
-  if (!gst_video_info_from_caps (&vinfo, caps)) {
-    GST_ERROR_OBJECT (dec, "Unable to parse downstream caps");
-    ret = FALSE;
-    goto exit;
+static void
+gst_g1_base_dec_release_frame (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstVideoCodecFrame *pending;
+
+  /* Still pending means no picture came out of it */
+  pending = gst_video_decoder_get_frame (bdec, frame->system_frame_number);
+  if (pending) {
+    gst_video_codec_frame_unref (pending);
+    gst_video_decoder_drop_frame (bdec, frame);
+  } else {
+    gst_video_codec_frame_unref (frame);
   }
+}
 
-  state->info = vinfo;
-  state->caps = caps;
+static void
+gst_g1_base_dec_queue_output (GstG1BaseDec * dec, GstVideoCodecFrame * frame,
+    gboolean finish, GstBuffer * analytics)
+{
+  GstG1BaseDecOutput *output;
 
-#define Y 0
-#define CbCr 1
-  GST_VIDEO_INFO_PLANE_OFFSET (&state->info, Y) = 0;
-  GST_VIDEO_INFO_PLANE_OFFSET (&state->info, CbCr) =
-      GST_VIDEO_INFO_WIDTH (&vinfo) * GST_VIDEO_INFO_HEIGHT (&vinfo);
+  output = g_slice_new (GstG1BaseDecOutput);
+  output->frame = frame;
+  output->finish = finish;
+  output->interlaced = dec->pp_interlaced;
+  output->analytics = analytics;
 
-  gst_video_decoder_set_output_state (decoder,
-      GST_VIDEO_FORMAT_INFO_FORMAT (vinfo.finfo),
-      GST_VIDEO_INFO_WIDTH (&vinfo), GST_VIDEO_INFO_HEIGHT (&vinfo), state);
-  gst_video_decoder_negotiate (decoder);
+  g_queue_push_tail (&dec->output_queue, output);
+  g_cond_broadcast (&dec->async_cond);
+}
 
-  /* Cropping depends on output format */
-  gst_g1_base_dec_config_crop (dec, dec->crop_x, dec->crop_y,
-      dec->crop_width, dec->crop_height);
+static void
+gst_g1_base_dec_clear_queues (GstG1BaseDec * dec)
+{
+  GstVideoCodecFrame *frame;
+  GstG1BaseDecOutput *output;
 
-exit:
-  {
-    if (desc)
-      g_free (desc);
-    return ret;
+  while ((frame = g_queue_pop_head (&dec->input_queue)))
+    gst_video_codec_frame_unref (frame);
+
+  while ((output = g_queue_pop_head (&dec->output_queue))) {
+    gst_video_codec_frame_unref (output->frame);
+    if (output->analytics)
+      gst_buffer_unref (output->analytics);
+    g_slice_free (GstG1BaseDecOutput, output);
   }
 }
 
-static gboolean
-gst_g1_base_dec_close (GstVideoDecoder * decoder)
+static gpointer
+gst_g1_base_dec_worker (gpointer data)
 {
-  GstG1BaseDec *g1dec;
+  GstG1BaseDec *dec = GST_G1_BASE_DEC (data);
   GstG1BaseDecClass *g1decclass;
+  GstVideoCodecFrame *frame;
+  GstClockTime start, end;
+  GstFlowReturn ret;
+  gboolean release;
 
-  g1dec = GST_G1_BASE_DEC (decoder);
-  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (g1dec));
+  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (dec));
 
-  GST_DEBUG_OBJECT (decoder, "close G1 decoder");
+  GST_DEBUG_OBJECT (dec, "worker thread started");
 
-  PPRelease (g1dec->pp);
-  g1dec->pp = NULL;
+  g_mutex_lock (&dec->async_lock);
+  while (TRUE) {
+    while (!dec->worker_stop && g_queue_is_empty (&dec->input_queue))
+      g_cond_wait (&dec->async_cond, &dec->async_lock);
 
-  g_return_val_if_fail (g1decclass->close, FALSE);
-  return g1decclass->close (g1dec);
+    if (dec->worker_stop)
+      break;
+
+    frame = g_queue_pop_head (&dec->input_queue);
+    dec->worker_frame = frame;
+    g_mutex_unlock (&dec->async_lock);
+
+    gst_g1_base_dec_native_wait (dec, FALSE);
+
+    start = gst_util_get_timestamp ();
+    ret = g1decclass->decode (dec, frame);
+    end = gst_util_get_timestamp ();
+    GST_CAT_DEBUG (GST_CAT_PERFORMANCE, "Processed buffer in %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (end - start));
+
+    release = gst_g1_base_dec_frame_done (dec, frame);
+
+    g_mutex_lock (&dec->async_lock);
+    dec->worker_frame = NULL;
+    g_cond_broadcast (&dec->async_cond);
+
+    if (dec->flushing) {
+      if (release)
+        gst_video_codec_frame_unref (frame);
+      continue;
+    }
+
+    if (GST_FLOW_OK != ret && GST_FLOW_OK == dec->async_ret)
+      dec->async_ret = ret;
+
+    /* Let the streaming thread release the frame after pushing any
+       picture queued before, same as it does when decoding
+       synchronously */
+    if (release)
+      gst_g1_base_dec_queue_output (dec, frame, FALSE, NULL);
+  }
+  g_mutex_unlock (&dec->async_lock);
+
+  GST_DEBUG_OBJECT (dec, "worker thread stopped");
+
+  return NULL;
 }
 
-int
-divRoundClosest (const int n, const int d)
+/* Must be called with the async lock and the stream lock held. The
+   worker never takes the stream lock, so it is kept while waiting */
+static GstFlowReturn
+gst_g1_base_dec_async_wait (GstG1BaseDec * dec, guint pending)
 {
-  return ((n < 0) ^ (d < 0)) ? ((n - d / 2) / d) : ((n + d / 2) / d);
-}
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstG1BaseDecOutput *output;
+  GstFlowReturn ret, fret;
+  GstClockTime start;
+
+  ret = GST_FLOW_OK;
+
+  while (TRUE) {
+    /* Push pictures downstream while the hardware works on the next
+       frames */
+    while ((output = g_queue_pop_head (&dec->output_queue))) {
+      g_mutex_unlock (&dec->async_lock);
+
+      if (output->analytics)
+        gst_g1_base_dec_push_analytics (dec, output->analytics);
+
+      if (output->finish) {
+        gst_g1_base_dec_output_interlace (dec, output->interlaced);
+        start = gst_util_get_timestamp ();
+        fret = gst_video_decoder_finish_frame (bdec, output->frame);
+        gst_g1_base_dec_record (dec, GST_G1_BASE_DEC_STAGE_PUSH,
+            gst_util_get_timestamp () - start);
+      } else {
+        gst_g1_base_dec_release_frame (dec, output->frame);
+        fret = GST_FLOW_OK;
+      }
+      g_slice_free (GstG1BaseDecOutput, output);
 
+      if (GST_FLOW_OK == ret)
+        ret = fret;
 
-GstFlowReturn
-gst_g1_base_dec_allocate_output (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+      g_mutex_lock (&dec->async_lock);
+    }
+
+    if (GST_FLOW_OK != ret)
+      break;
+
+    if (dec->flushing) {
+      ret = GST_FLOW_FLUSHING;
+      break;
+    }
+
+    if (GST_FLOW_OK != dec->async_ret) {
+      ret = dec->async_ret;
+      break;
+    }
+
+    /* The worker waits for the output to follow a new stream size.
+       Pictures of the old size are drained and pushed first. */
+    if (dec->resize_pending) {
+      g_mutex_unlock (&dec->async_lock);
+      if (dec->resize_changed && !dec->resize_drained) {
+        gst_g1_base_dec_resize_drain (dec);
+        g_mutex_lock (&dec->async_lock);
+        dec->resize_drained = TRUE;
+        continue;
+      }
+      gst_g1_base_dec_resize_output (dec, dec->resize_changed,
+          dec->resize_width, dec->resize_height);
+      g_mutex_lock (&dec->async_lock);
+      dec->resize_pending = FALSE;
+      g_cond_broadcast (&dec->async_cond);
+      continue;
+    }
+
+    if (g_queue_get_length (&dec->input_queue) + (dec->worker_frame ? 1 : 0)
+        <= pending)
+      break;
+
+    g_cond_wait (&dec->async_cond, &dec->async_lock);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_g1_base_dec_async_decode (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
 {
-  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
-  GstVideoCodecState *state;
-  GstVideoInfo *vinfo;
-  GstVideoFormatInfo *finfo;
-  GstMemory *mem;
-  GstMapInfo minfo;
-  guint32 physaddress = NULL;
   GstFlowReturn ret;
-  PPResult ppret;
-  GstAllocationParams params = (const GstAllocationParams) { 0 };
-  guint32 size;
-  GstKMSMemory *kmsmem = NULL;
 
-  g_return_val_if_fail (dec, GST_FLOW_ERROR);
-  g_return_val_if_fail (frame, GST_FLOW_ERROR);
+  if (!dec->worker) {
+    dec->worker_stop = FALSE;
+    dec->async_ret = GST_FLOW_OK;
+    dec->worker = g_thread_new ("g1worker", gst_g1_base_dec_worker, dec);
+  }
+
+  g_mutex_lock (&dec->async_lock);
+  if (dec->flushing) {
+    g_mutex_unlock (&dec->async_lock);
+    gst_video_decoder_drop_frame (GST_VIDEO_DECODER (dec), frame);
+    return GST_FLOW_FLUSHING;
+  }
+
+  /* The worker takes output buffers straight from the pool, downstream
+     asked for a new one so renegotiate while it is idle */
+  if (gst_pad_check_reconfigure (GST_VIDEO_DECODER_SRC_PAD (dec))) {
+    ret = gst_g1_base_dec_async_wait (dec, 0);
+    g_mutex_unlock (&dec->async_lock);
+
+    if (GST_FLOW_OK == ret &&
+        !gst_video_decoder_negotiate (GST_VIDEO_DECODER (dec))) {
+      gst_pad_mark_reconfigure (GST_VIDEO_DECODER_SRC_PAD (dec));
+      ret = GST_FLOW_NOT_NEGOTIATED;
+    }
+    if (GST_FLOW_OK != ret) {
+      gst_video_decoder_drop_frame (GST_VIDEO_DECODER (dec), frame);
+      return ret;
+    }
+
+    g_mutex_lock (&dec->async_lock);
+  }
+
+  g_queue_push_tail (&dec->input_queue, frame);
+  g_cond_broadcast (&dec->async_cond);
+
+  ret = gst_g1_base_dec_async_wait (dec, ASYNC_QUEUE_SIZE);
+  g_mutex_unlock (&dec->async_lock);
+
+  return ret;
+}
+
+/* Hands a new stream size over to the streaming thread, which owns the
+   output state, and waits for it to be done with it */
+static void
+gst_g1_base_dec_async_resize (GstG1BaseDec * dec, gboolean resized,
+    gint32 width, gint32 height)
+{
+  g_mutex_lock (&dec->async_lock);
+
+  dec->resize_changed = resized;
+  dec->resize_drained = FALSE;
+  dec->resize_width = width;
+  dec->resize_height = height;
+  dec->resize_pending = TRUE;
+  g_cond_broadcast (&dec->async_cond);
+
+  while (dec->resize_pending && !dec->flushing)
+    g_cond_wait (&dec->async_cond, &dec->async_lock);
+  dec->resize_pending = FALSE;
+
+  g_mutex_unlock (&dec->async_lock);
+}
+
+static void
+gst_g1_base_dec_async_flush (GstG1BaseDec * dec, gboolean start)
+{
+  /* Downstream drops the pictures it holds, don't wait for them */
+  g_mutex_lock (&dec->native_lock);
+  dec->native_flushing = start;
+  g_cond_broadcast (&dec->native_cond);
+  g_mutex_unlock (&dec->native_lock);
+
+  g_mutex_lock (&dec->async_lock);
+
+  if (start) {
+    /* Pending frames are discarded, wake up anyone waiting on them */
+    dec->flushing = TRUE;
+    gst_g1_base_dec_clear_queues (dec);
+    g_cond_broadcast (&dec->async_cond);
+  } else {
+    while (dec->worker_frame)
+      g_cond_wait (&dec->async_cond, &dec->async_lock);
+
+    gst_g1_base_dec_clear_queues (dec);
+    dec->flushing = FALSE;
+    dec->async_ret = GST_FLOW_OK;
+
+    /* Pictures from before the flush are never output */
+    g_hash_table_remove_all (dec->pictures);
+    gst_buffer_replace (&dec->output_buffer, NULL);
+  }
+
+  g_mutex_unlock (&dec->async_lock);
+}
+
+/* Unblocks whoever waits for an output buffer while flushing */
+static void
+gst_g1_base_dec_flush_pool (GstG1BaseDec * dec, gboolean flushing)
+{
+  GstBufferPool *pool;
+
+  pool = gst_video_decoder_get_buffer_pool (GST_VIDEO_DECODER (dec));
+  if (!pool)
+    return;
+
+#if GST_CHECK_VERSION(1,4,0)
+  gst_buffer_pool_set_flushing (pool, flushing);
+#else
+  gst_buffer_pool_set_active (pool, !flushing);
+#endif
+  gst_object_unref (pool);
+}
+
+static void
+gst_g1_base_dec_stop_worker (GstG1BaseDec * dec)
+{
+  GstBufferPool *pool;
+
+  if (!dec->worker)
+    return;
+
+  GST_DEBUG_OBJECT (dec, "stopping worker thread");
+
+  gst_g1_base_dec_async_flush (dec, TRUE);
+
+  /* Don't let the worker block waiting for an output buffer, the pool
+     is configured and activated again on the next negotiation */
+  pool = gst_video_decoder_get_buffer_pool (GST_VIDEO_DECODER (dec));
+  if (pool) {
+    gst_buffer_pool_set_active (pool, FALSE);
+    gst_object_unref (pool);
+  }
+
+  g_mutex_lock (&dec->async_lock);
+  dec->worker_stop = TRUE;
+  g_cond_broadcast (&dec->async_cond);
+  g_mutex_unlock (&dec->async_lock);
+
+  g_thread_join (dec->worker);
+  dec->worker = NULL;
+
+  gst_g1_base_dec_async_flush (dec, FALSE);
+}
+
+/* Whether the codec pictures can go out as they are, because the post
+   processor would only copy them. Must be called with the pp lock held */
+static gboolean
+gst_g1_base_dec_can_bypass (GstG1BaseDec * dec, GstVideoInfo * vinfo)
+{
+  PPConfig *config = &dec->ppconfig;
+
+  /* Downstream may only keep pictures the codec won't overwrite */
+  if (!dec->native_max)
+    return FALSE;
+
+  /* Colour adjustments only apply to RGB output */
+  return config->ppInImg.pixFormat == PP_PIX_FMT_YCBCR_4_2_0_SEMIPLANAR &&
+      GST_VIDEO_INFO_FORMAT (vinfo) == GST_VIDEO_FORMAT_NV12 &&
+      GST_VIDEO_INFO_WIDTH (vinfo) == config->ppInImg.width &&
+      GST_VIDEO_INFO_HEIGHT (vinfo) == config->ppInImg.height &&
+      !config->ppInCrop.enable && !config->ppOutMask1.enable &&
+      !config->ppOutMask2.enable && !config->ppOutDeinterlace.enable &&
+      config->ppInRotation.rotation == PP_ROTATION_NONE;
+}
+
+/* Crops the input to the window of the picture post processed next,
+   grown to the alignment of the post processor and to a third of the
+   output size, the most it upscales. Pictures without one get the crop
+   properties back. Must be called with the pp lock held */
+static void
+gst_g1_base_dec_config_roi (GstG1BaseDec * dec, GstVideoInfo * vinfo,
+    GstG1BaseDecCrop * crop)
+{
+  PPInCropping *config = &dec->ppconfig.ppInCrop;
+  guint inwidth, inheight, x, y, width, height;
+
+  if (!crop) {
+    if (dec->roi_active) {
+      dec->roi_active = FALSE;
+      gst_g1_base_dec_config_crop (dec, -1, -1, -1, -1);
+    }
+    return;
+  }
+
+  inwidth = dec->ppconfig.ppInImg.width;
+  inheight = dec->ppconfig.ppInImg.height;
+
+  x = MIN (crop->x, inwidth) & ~0xf;
+  width = GST_ROUND_UP_8 (MIN (crop->x + crop->width, inwidth) - x);
+  width = MAX (width, GST_ROUND_UP_8 ((GST_VIDEO_INFO_WIDTH (vinfo) + 2) / 3));
+  width = MIN (width, inwidth & ~0x7);
+  if (x + width > inwidth)
+    x = (inwidth - width) & ~0xf;
+
+  y = MIN (crop->y, inheight) & ~0xf;
+  height = GST_ROUND_UP_8 (MIN (crop->y + crop->height, inheight) - y);
+  height = MAX (height,
+      GST_ROUND_UP_8 ((GST_VIDEO_INFO_HEIGHT (vinfo) + 4) / 3));
+  height = MIN (height, inheight & ~0x7);
+  if (y + height > inheight)
+    y = (inheight - height) & ~0xf;
+
+  dec->roi_active = TRUE;
+
+  if (config->enable && config->originX == x && config->originY == y &&
+      config->width == width && config->height == height)
+    return;
+
+  GST_LOG_OBJECT (dec, "cropping %ux%u at %u,%u", width, height, x, y);
+
+  config->enable = 1;
+  config->originX = x;
+  config->originY = y;
+  config->width = width;
+  config->height = height;
+  dec->pp_dirty |= PP_DIRTY_CROP;
+}
+
+/* Uploads the pixels of an overlay rectangle for a mask, unless they
+   are there already. Must be called with the pp lock held */
+static gboolean
+gst_g1_base_dec_upload_overlay (GstG1BaseDec * dec, guint mask,
+    GstVideoOverlayRectangle * rectangle)
+{
+  GstVideoMeta *meta;
+  GstMapInfo map;
+  GstBuffer *pixels;
+  guint8 *dest;
+  gsize size;
+  guint width, height, stride, i;
+
+  pixels = gst_video_overlay_rectangle_get_pixels_argb (rectangle,
+      GST_VIDEO_OVERLAY_FORMAT_FLAG_NONE);
+  meta = gst_buffer_get_video_meta (pixels);
+  g_return_val_if_fail (meta, FALSE);
+
+  width = meta->width;
+  height = meta->height;
+  stride = meta->stride[0];
+
+  /* The same rectangle is usually shown over many pictures */
+  if (dec->overlay_mem[mask] && dec->overlay_seqnum[mask] ==
+      gst_video_overlay_rectangle_get_seqnum (rectangle))
+    return TRUE;
+
+  /* The post processor reads 32 bit ARGB words, same as the overlay */
+  size = width * height * 4;
+  if (dec->overlay_mem[mask] &&
+      dec->overlay_mem[mask]->mem.maxsize < size) {
+    gst_allocator_free (dec->allocator, (GstMemory *) dec->overlay_mem[mask]);
+    dec->overlay_mem[mask] = NULL;
+  }
+
+  if (!dec->overlay_mem[mask]) {
+    dec->overlay_mem[mask] =
+        (GstG1Memory *) gst_allocator_alloc (dec->allocator, size, NULL);
+    if (!dec->overlay_mem[mask]) {
+      GST_ERROR_OBJECT (dec, "unable to allocate %" G_GSIZE_FORMAT " bytes "
+          "for overlay", size);
+      return FALSE;
+    }
+  }
+
+  if (!gst_buffer_map (pixels, &map, GST_MAP_READ)) {
+    GST_ERROR_OBJECT (dec, "unable to map overlay pixels");
+    return FALSE;
+  }
+
+  dest = dec->overlay_mem[mask]->virtaddress;
+  for (i = 0; i < height; i++)
+    memcpy (dest + i * width * 4, map.data + meta->offset[0] + i * stride,
+        width * 4);
+
+  gst_buffer_unmap (pixels, &map);
+
+  dec->overlay_seqnum[mask] =
+      gst_video_overlay_rectangle_get_seqnum (rectangle);
+
+  GST_DEBUG_OBJECT (dec, "uploaded %ux%u overlay for mask %u", width, height,
+      mask + 1);
+
+  return TRUE;
+}
+
+/* Blends the rectangles of the overlay composition of the picture post
+   processed next with the post processor masks. Mask 1 is only taken when no
+   mask file is configured, rectangles beyond the free masks are left
+   out. Must be called with the pp lock held */
+static void
+gst_g1_base_dec_config_overlay (GstG1BaseDec * dec, GstVideoInfo * vinfo,
+    GstVideoOverlayComposition * overlay)
+{
+  GstVideoOverlayRectangle *rectangle;
+  gint x, y, x1, y1, rx, ry;
+  guint rwidth, rheight, n, i, mask, used = 0;
+  guint32 base;
+
+  n = overlay ? gst_video_overlay_composition_n_rectangles (overlay) : 0;
+  mask = dec->mask1_location ? 1 : 0;
+
+  for (i = 0; i < n && mask < GST_G1_BASE_DEC_OVERLAY_MASKS; i++) {
+    rectangle = gst_video_overlay_composition_get_rectangle (overlay, i);
+    gst_video_overlay_rectangle_get_render_rectangle (rectangle, &rx, &ry,
+        &rwidth, &rheight);
+
+    /* Rectangles are placed on the output picture, clip them to it */
+    x = MAX (rx, 0);
+    y = MAX (ry, 0);
+    x1 = MIN (rx + (gint) rwidth, GST_VIDEO_INFO_WIDTH (vinfo));
+    y1 = MIN (ry + (gint) rheight, GST_VIDEO_INFO_HEIGHT (vinfo));
+    if (x1 <= x || y1 <= y)
+      continue;
+
+    if (!gst_g1_base_dec_upload_overlay (dec, mask, rectangle))
+      continue;
+
+    base = dec->overlay_mem[mask]->physaddress;
+    if (mask == 0) {
+      PP_MASK_BLEND (dec->ppconfig.ppOutMask1, x, y, x1 - x, y1 - y, x - rx,
+          y - ry, rwidth, rheight, base);
+      dec->pp_dirty |= PP_DIRTY_MASK1;
+    } else {
+      PP_MASK_BLEND (dec->ppconfig.ppOutMask2, x, y, x1 - x, y1 - y, x - rx,
+          y - ry, rwidth, rheight, base);
+      dec->pp_dirty |= PP_DIRTY_MASK2;
+    }
+
+    used |= 1 << mask;
+    mask++;
+  }
+
+  if (i < n)
+    GST_LOG_OBJECT (dec, "no mask left for %u overlay rectangles", n - i);
+
+  /* Give the masks the overlays don't take anymore back */
+  if ((dec->overlay_masks & ~used) & (1 << 0))
+    gst_g1_base_dec_config_mask1 (dec, (gpointer) - 1, -1, -1, -1, -1);
+
+  if ((dec->overlay_masks & ~used) & (1 << 1)) {
+    dec->ppconfig.ppOutMask2.enable = 0;
+    dec->ppconfig.ppOutMask2.alphaBlendEna = 0;
+    dec->pp_dirty |= PP_DIRTY_MASK2;
+  }
+
+  dec->overlay_masks = used;
+}
+
+/* Chains the post processor to the codec, or lets the codec run on its
+   own and output its pictures directly */
+static gboolean
+gst_g1_base_dec_config_bypass (GstG1BaseDec * dec, gboolean bypass)
+{
+  PPResult ppret;
+
+  if (bypass == dec->pp_bypass)
+    return TRUE;
+
+  if (bypass)
+    ppret = PPDecCombinedModeDisable (dec->pp, dec->codec);
+  else
+    ppret = PPDecCombinedModeEnable (dec->pp, dec->codec, dec->dectype);
+
+  if (GST_G1_PP_FAILED (ppret)) {
+    GST_ERROR_OBJECT (dec, "Failed to %s post processor, %s",
+        bypass ? "unchain" : "chain", gst_g1_result_pp (ppret));
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (dec, "post processor %s", bypass ? "bypassed" : "chained");
+
+  dec->pp_bypass = bypass;
+
+  /* Reprogram it from scratch when it's chained again */
+  g_mutex_lock (&dec->pp_lock);
+  dec->pp_dirty = PP_DIRTY_ALL;
+  g_mutex_unlock (&dec->pp_lock);
+  gst_g1_base_dec_reset_multibuffer (dec);
+
+  return TRUE;
+}
+
+static gboolean
+gst_g1_base_dec_set_format (GstVideoDecoder * decoder,
+    GstVideoCodecState * state)
+{
+  GstG1BaseDec *dec = GST_G1_BASE_DEC (decoder);
+  GstStructure *structure;
+  GstCaps *caps;
+  GstVideoInfo vinfo;
+  gint width, height;
+  gboolean ret;
+  gchar *desc = NULL;
+
+  /* The worker configures the post processor and takes output buffers
+     for the frames queued so far, let it finish them first */
+  if (dec->worker) {
+    g_mutex_lock (&dec->async_lock);
+    gst_g1_base_dec_async_wait (dec, 0);
+    g_mutex_unlock (&dec->async_lock);
+  }
+
+  if (dec->dectype != PP_PIPELINED_DEC_TYPE_H264)
+    gst_g1_base_dec_stream_header (decoder);
+
+  caps = gst_pad_get_allowed_caps (GST_VIDEO_DECODER_SRC_PAD (decoder));
+
+  if (gst_caps_is_empty (caps)) {
+    GST_ERROR_OBJECT (dec, "no output format downstream accepts");
+    gst_caps_unref (caps);
+    return FALSE;
+  }
+
+  /* Downstream leaving the size open, the output follows the stream */
+  structure = gst_caps_get_structure (caps, 0);
+  dec->follow_input =
+      !gst_structure_has_field_typed (structure, "width", G_TYPE_INT) ||
+      !gst_structure_has_field_typed (structure, "height", G_TYPE_INT);
+
+  caps = gst_caps_fixate (caps);
+  desc = gst_caps_to_string (caps);
+
+  GST_DEBUG_OBJECT (dec, "Parsed %s from downstream", desc);
+
+  if (!gst_video_info_from_caps (&vinfo, caps)) {
+    GST_ERROR_OBJECT (dec, "Unable to parse downstream caps");
+    ret = FALSE;
+    goto exit;
+  }
+
+  state->info = vinfo;
+  state->caps = caps;
+
+  /* Start at the size of the stream if it is known already, otherwise
+     the output follows it once the headers are parsed */
+  width = GST_VIDEO_INFO_WIDTH (&vinfo);
+  height = GST_VIDEO_INFO_HEIGHT (&vinfo);
+  g_mutex_lock (&dec->pp_lock);
+  if (dec->follow_input && dec->ppconfig.ppInImg.width &&
+      dec->ppconfig.ppInImg.height) {
+    width = dec->ppconfig.ppInImg.width;
+    height = dec->ppconfig.ppInImg.height;
+  }
+  g_mutex_unlock (&dec->pp_lock);
+
+  gst_video_decoder_set_output_state (decoder,
+      GST_VIDEO_FORMAT_INFO_FORMAT (vinfo.finfo), width, height, state);
+  gst_video_decoder_negotiate (decoder);
+
+  /* Cropping depends on output format */
+  g_mutex_lock (&dec->pp_lock);
+  dec->out_width = width;
+  dec->out_height = height;
+  gst_g1_base_dec_config_crop (dec, dec->crop_x, dec->crop_y,
+      dec->crop_width, dec->crop_height);
+  dec->pp_dirty |= PP_DIRTY_OUTPUT;
+  g_mutex_unlock (&dec->pp_lock);
+
+  ret = TRUE;
+
+exit:
+  {
+    if (desc)
+      g_free (desc);
+    return ret;
+  }
+}
+
+static gboolean
+gst_g1_base_dec_stop (GstVideoDecoder * decoder)
+{
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
+
+  gst_g1_base_dec_stop_worker (g1dec);
+
+  g_hash_table_remove_all (g1dec->pictures);
+  gst_buffer_replace (&g1dec->output_buffer, NULL);
+  gst_g1_base_dec_reset_multibuffer (g1dec);
+  gst_object_replace ((GstObject **) & g1dec->output_pool, NULL);
+  gst_g1_base_dec_reset_analytics (g1dec);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_g1_base_dec_drain_pictures (GstG1BaseDec * g1dec)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (g1dec);
+  GstG1BaseDecClass *g1decclass;
+  GstVideoCodecFrame *frame;
+  GHashTableIter iter;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (g1dec));
+
+  /* Wait for the worker to decode everything that was queued, the
+     hardware is ours until the next frame is queued */
+  if (g1dec->worker) {
+    g_mutex_lock (&g1dec->async_lock);
+    ret = gst_g1_base_dec_async_wait (g1dec, 0);
+    g_mutex_unlock (&g1dec->async_lock);
+    if (GST_FLOW_OK != ret)
+      return ret;
+  }
+
+  if (g1decclass->drain && g1dec->codec)
+    ret = g1decclass->drain (g1dec);
+  gst_buffer_replace (&g1dec->output_buffer, NULL);
+
+  if (g1dec->worker) {
+    g_mutex_lock (&g1dec->async_lock);
+    if (GST_FLOW_OK == ret)
+      ret = gst_g1_base_dec_async_wait (g1dec, 0);
+    g_mutex_unlock (&g1dec->async_lock);
+  }
+
+  /* Whatever the hardware didn't give back is lost */
+  g_hash_table_iter_init (&iter, g1dec->pictures);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & frame)) {
+    GST_WARNING_OBJECT (g1dec, "picture %d was never output",
+        frame->system_frame_number);
+    g_hash_table_iter_steal (&iter);
+    gst_video_decoder_drop_frame (decoder, frame);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_g1_base_dec_finish (GstVideoDecoder * decoder)
+{
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
+
+  GST_DEBUG_OBJECT (g1dec, "end of stream, draining pending pictures");
+
+  return gst_g1_base_dec_drain_pictures (g1dec);
+}
+
+static GstFlowReturn
+gst_g1_base_dec_drain (GstVideoDecoder * decoder)
+{
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
+
+  GST_DEBUG_OBJECT (g1dec, "draining pending pictures");
+
+  return gst_g1_base_dec_drain_pictures (g1dec);
+}
+
+static gboolean
+gst_g1_base_dec_flush (GstVideoDecoder * decoder)
+{
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
+  GstG1BaseDecClass *g1decclass;
+
+  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (g1dec));
+
+  GST_DEBUG_OBJECT (g1dec, "flushing decoder");
+
+  /* Emptying the DPB is enough to restart decoding at the next key
+     frame, without going through the codec and post processor
+     initialization again. With the picture table emptied first the
+     pictures coming out are discarded, and with the post processor
+     left out they are neither given an output buffer nor processed. */
+  g_hash_table_remove_all (g1dec->pictures);
+  gst_buffer_replace (&g1dec->output_buffer, NULL);
+  if (g1decclass->drain && g1dec->codec &&
+      gst_g1_base_dec_skip_pictures (g1dec, TRUE)) {
+    g1decclass->drain (g1dec);
+    gst_g1_base_dec_skip_pictures (g1dec, FALSE);
+  }
+
+  /* Program the post processor from scratch on the next picture */
+  gst_g1_base_dec_reset_multibuffer (g1dec);
+
+  return TRUE;
+}
+
+/* Takes the crop window of a g1-crop event, returns FALSE if it is some
+   other event */
+static gboolean
+gst_g1_base_dec_crop_event (GstG1BaseDec * dec, GstEvent * event)
+{
+  const GstStructure *structure;
+  guint x = 0, y = 0, width = 0, height = 0;
+
+  structure = gst_event_get_structure (event);
+  if (!structure || !gst_structure_has_name (structure, CROP_EVENT_NAME))
+    return FALSE;
+
+  /* A window without a size goes back to the crop properties */
+  gst_structure_get_uint (structure, "x", &x);
+  gst_structure_get_uint (structure, "y", &y);
+  gst_structure_get_uint (structure, "width", &width);
+  gst_structure_get_uint (structure, "height", &height);
+
+  GST_DEBUG_OBJECT (dec, "crop window %ux%u at %u,%u", width, height, x, y);
+
+  g_mutex_lock (&dec->pp_lock);
+  dec->roi_x = x;
+  dec->roi_y = y;
+  dec->roi_width = width && height ? width : 0;
+  dec->roi_height = width && height ? height : 0;
+  g_mutex_unlock (&dec->pp_lock);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+/* Takes the composition of a g1-overlay event, returns FALSE if it is
+   some other event */
+static gboolean
+gst_g1_base_dec_overlay_event (GstG1BaseDec * dec, GstEvent * event)
+{
+  const GstStructure *structure;
+  GstVideoOverlayComposition *overlay = NULL;
+
+  structure = gst_event_get_structure (event);
+  if (!structure || !gst_structure_has_name (structure, OVERLAY_EVENT_NAME))
+    return FALSE;
+
+  /* An event without one removes the overlays */
+  gst_structure_get (structure, "composition",
+      GST_TYPE_VIDEO_OVERLAY_COMPOSITION, &overlay, NULL);
+
+  GST_DEBUG_OBJECT (dec, "overlay composition of %u rectangles",
+      overlay ? gst_video_overlay_composition_n_rectangles (overlay) : 0);
+
+  g_mutex_lock (&dec->pp_lock);
+  if (dec->overlay)
+    gst_video_overlay_composition_unref (dec->overlay);
+  dec->overlay = overlay;
+  g_mutex_unlock (&dec->pp_lock);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static gboolean
+gst_g1_base_dec_src_event (GstVideoDecoder * decoder, GstEvent * event)
+{
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
+
+  /* Applications send them to the element, they end up here */
+  if (GST_EVENT_CUSTOM_UPSTREAM == GST_EVENT_TYPE (event) &&
+      (gst_g1_base_dec_crop_event (g1dec, event) ||
+          gst_g1_base_dec_overlay_event (g1dec, event)))
+    return TRUE;
+
+  return GST_VIDEO_DECODER_CLASS (parent_class)->src_event (decoder, event);
+}
+
+static gboolean
+gst_g1_base_dec_sink_event (GstVideoDecoder * decoder, GstEvent * event)
+{
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
+  GstEvent *forward = NULL;
+  GstPad *analytics;
+  gboolean ret;
+
+  /* Serialized, they apply to the frames that follow them */
+  if (GST_EVENT_CUSTOM_DOWNSTREAM == GST_EVENT_TYPE (event) &&
+      (gst_g1_base_dec_crop_event (g1dec, event) ||
+          gst_g1_base_dec_overlay_event (g1dec, event)))
+    return TRUE;
+
+  analytics = gst_g1_base_dec_get_analytics_pad (g1dec);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      /* Unblock the worker if it is pushing to the analytics pad */
+      if (analytics)
+        gst_pad_push_event (analytics, gst_event_ref (event));
+      gst_g1_base_dec_async_flush (g1dec, TRUE);
+      gst_g1_base_dec_flush_pool (g1dec, TRUE);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_g1_base_dec_async_flush (g1dec, FALSE);
+      gst_g1_base_dec_flush_pool (g1dec, FALSE);
+      forward = gst_event_ref (event);
+      break;
+    case GST_EVENT_SEGMENT:
+      /* Otherwise it is sent along with the caps */
+      if (g1dec->analytics_pool)
+        forward = gst_event_ref (event);
+      break;
+    case GST_EVENT_EOS:
+      /* After the pictures pushed while draining */
+      forward = gst_event_ref (event);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_VIDEO_DECODER_CLASS (parent_class)->sink_event (decoder, event);
+
+  if (analytics) {
+    if (forward)
+      gst_pad_push_event (analytics, forward);
+    gst_object_unref (analytics);
+  } else if (forward) {
+    gst_event_unref (forward);
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_g1_base_dec_close (GstVideoDecoder * decoder)
+{
+  GstG1BaseDec *g1dec;
+  GstG1BaseDecClass *g1decclass;
+  guint i;
+
+  g1dec = GST_G1_BASE_DEC (decoder);
+  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (g1dec));
+
+  GST_DEBUG_OBJECT (decoder, "close G1 decoder");
+
+  PPRelease (g1dec->pp);
+  g1dec->pp = NULL;
+
+  if (g1dec->analytics_pp) {
+    PPRelease (g1dec->analytics_pp);
+    g1dec->analytics_pp = NULL;
+  }
+
+  g_mutex_lock (&g1dec->pp_lock);
+  for (i = 0; i < GST_G1_BASE_DEC_OVERLAY_MASKS; i++) {
+    if (g1dec->overlay_mem[i]) {
+      gst_allocator_free (g1dec->allocator,
+          (GstMemory *) g1dec->overlay_mem[i]);
+      g1dec->overlay_mem[i] = NULL;
+    }
+  }
+  g1dec->overlay_masks = 0;
+  if (g1dec->mask1_mem) {
+    gst_allocator_free (g1dec->allocator, (GstMemory *) g1dec->mask1_mem);
+    g1dec->mask1_mem = NULL;
+  }
+  g1dec->out_width = 0;
+  g1dec->out_height = 0;
+  g_mutex_unlock (&g1dec->pp_lock);
+
+  if (g1dec->scheduler) {
+    guint64 jobs;
+    GstClockTime busy;
+
+    busy = gst_g1_scheduler_get_busy_time (g1dec->scheduler, &jobs);
+    GST_CAT_INFO_OBJECT (GST_CAT_PERFORMANCE, g1dec, "%" G_GUINT64_FORMAT
+        " hardware jobs in %" GST_TIME_FORMAT, jobs, GST_TIME_ARGS (busy));
+
+    g_mutex_lock (&g1dec->pp_lock);
+    gst_g1_scheduler_unregister (g1dec->scheduler);
+    g1dec->scheduler = NULL;
+    g_mutex_unlock (&g1dec->pp_lock);
+  }
+
+  /* Releasing the codec frees the pictures downstream may still hold */
+  gst_g1_base_dec_native_wait (g1dec, TRUE);
+  g1dec->native_outputs = 0;
+
+  gst_g1_base_dec_free_ring (g1dec);
+
+  g_return_val_if_fail (g1decclass->close, FALSE);
+  return g1decclass->close (g1dec);
+}
+
+int
+divRoundClosest (const int n, const int d)
+{
+  return ((n < 0) ^ (d < 0)) ? ((n - d / 2) / d) : ((n + d / 2) / d);
+}
+
+
+/* Allocates a buffer for the post processor. Buffers from a pool
+   preallocated for another resolution still describe the layout they
+   were first used with, update it */
+static GstBuffer *
+gst_g1_base_dec_new_output_buffer (GstG1BaseDec * dec, GstVideoInfo * vinfo)
+{
+  GstBufferPool *pool;
+  GstBuffer *buffer = NULL;
+  GstVideoMeta *meta;
+  GstVideoInfo aligned;
+
+  /* Allocating through the base class takes the stream lock, which the
+     worker must not wait for. The streaming thread negotiates for it. */
+  if (dec->worker && g_thread_self () == dec->worker) {
+    pool = gst_video_decoder_get_buffer_pool (GST_VIDEO_DECODER (dec));
+    if (pool) {
+      gst_buffer_pool_acquire_buffer (pool, &buffer, NULL);
+      gst_object_unref (pool);
+    }
+  } else {
+    buffer =
+        gst_video_decoder_allocate_output_buffer (GST_VIDEO_DECODER (dec));
+  }
+
+  if (!buffer)
+    return NULL;
+
+  /* The pool is kept across resolution changes, its buffers take the
+     current layout */
+  meta = gst_buffer_get_video_meta (buffer);
+  if (meta && (meta->format != GST_VIDEO_INFO_FORMAT (vinfo) ||
+          meta->width != GST_VIDEO_INFO_WIDTH (vinfo) ||
+          meta->height != GST_VIDEO_INFO_HEIGHT (vinfo))) {
+    aligned = *vinfo;
+    gst_format_g1_align (&aligned);
+
+    meta->format = GST_VIDEO_INFO_FORMAT (&aligned);
+    meta->width = GST_VIDEO_INFO_WIDTH (&aligned);
+    meta->height = GST_VIDEO_INFO_HEIGHT (&aligned);
+    meta->n_planes = GST_VIDEO_INFO_N_PLANES (&aligned);
+    memcpy (meta->offset, aligned.offset, sizeof (meta->offset));
+    memcpy (meta->stride, aligned.stride, sizeof (meta->stride));
+  }
+
+  return buffer;
+}
+
+/* Returns the physical address of the luma plane of a buffer, and of
+   the chroma plane in chroma, or 0 if not physically contiguous */
+static guint32
+gst_g1_base_dec_buffer_address (GstBuffer * buffer, GstVideoInfo * vinfo,
+    guint32 * chroma)
+{
+  GstVideoMeta *meta;
+  GstMemory *mem;
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  guint32 physaddress;
+
+  /*
+   * Buffers from the G1 pool already carry their physical address. If
+   * it is g1kmssink and zero-copy is enabled, then post processing
+   * module copies the video frames directly to the frame buffer.
+   */
+  mem = gst_buffer_peek_memory (buffer, 0);
+  if (GST_IS_G1_ALLOCATOR (mem->allocator))
+    physaddress = gst_g1_allocator_get_physical (mem);
+  else
+    physaddress = ((GstKMSMemory *) mem)->fb_phys_addr;
+
+  if (!physaddress)
+    return 0;
+
+  /* Pooled buffers describe their own (padded) layout, otherwise fall
+   * back to the negotiated one */
+  meta = gst_buffer_get_video_meta (buffer);
+  if (meta)
+    memcpy (offset, meta->offset, sizeof (offset));
+  else
+    memcpy (offset, vinfo->offset, sizeof (offset));
+
+  *chroma = physaddress + offset[1];
+  return physaddress + offset[0];
+}
+
+/* Must be called with the pp lock held */
+static void
+gst_g1_base_dec_config_output (GstG1BaseDec * dec, GstVideoInfo * vinfo)
+{
+  /* Width and Height of the video overlay taken from user */
+
+  dec->ppconfig.ppOutFrmBuffer.enable = 0;
+  dec->ppconfig.ppOutFrmBuffer.writeOriginX = dec->x;
+  dec->ppconfig.ppOutFrmBuffer.writeOriginY = dec->y;
+  dec->ppconfig.ppOutFrmBuffer.frameBufferWidth =
+      (divRoundClosest (dec->w, 16) * 16);
+  dec->ppconfig.ppOutFrmBuffer.frameBufferHeight =
+      (divRoundClosest (dec->h, 16) * 16);
+
+  dec->ppconfig.ppOutImg.width = GST_ROUND_UP_16 (GST_VIDEO_INFO_WIDTH (vinfo));
+  dec->ppconfig.ppOutImg.height =
+      GST_ROUND_UP_16 (GST_VIDEO_INFO_HEIGHT (vinfo));
+
+  dec->ppconfig.ppOutImg.pixFormat = gst_format_gst_to_g1 (vinfo->finfo);
+  dec->ppconfig.ppOutRgb.ditheringEnable = 1;
+}
+
+/* Programs the post processor from the shadow configuration. When only
+   the output address changed the sections aren't recomputed, and when
+   not even that changed there is nothing to do. Must be called with the
+   pp lock held */
+static GstFlowReturn
+gst_g1_base_dec_commit_config (GstG1BaseDec * dec, guint32 luma,
+    guint32 chroma)
+{
+  PPResult ppret;
+
+  if (!dec->pp_dirty && dec->ppconfig.ppOutImg.bufferBusAddr == luma &&
+      dec->ppconfig.ppOutImg.bufferChromaBusAddr == chroma)
+    return GST_FLOW_OK;
+
+  if (dec->pp_dirty)
+    GST_DEBUG_OBJECT (dec, "reprogramming post processor, dirty 0x%02x",
+        dec->pp_dirty);
+
+  GST_LOG_OBJECT (dec, "physical address for PP 0x%08x", luma);
+  dec->ppconfig.ppOutImg.bufferBusAddr = luma;
+  dec->ppconfig.ppOutImg.bufferChromaBusAddr = chroma;
+
+  ppret = PPSetConfig (dec->pp, &dec->ppconfig);
+  if (GST_G1_PP_FAILED (ppret)) {
+    GST_ERROR_OBJECT (dec, "ppsetconfig failed =%s",
+        gst_g1_result_pp (ppret));
+    /* Don't trust the hardware to hold any of it */
+    dec->pp_dirty = PP_DIRTY_ALL;
+    return GST_FLOW_ERROR;
+  }
+
+  dec->pp_dirty = 0;
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_g1_base_dec_reset_multibuffer (GstG1BaseDec * dec)
+{
+  /* Buffers downstream holds go back to the pool once released */
+  g_mutex_lock (&dec->native_lock);
+  memset (dec->multibuff_held, 0, sizeof (dec->multibuff_held));
+  g_mutex_unlock (&dec->native_lock);
+
+  g_ptr_array_set_size (dec->multibuff, 0);
+  dec->multibuff_config = (const PPOutputBuffers) { 0 };
+  dec->multibuff_next = 0;
+
+  if (dec->multibuff_pool) {
+    gst_object_unref (dec->multibuff_pool);
+    dec->multibuff_pool = NULL;
+  }
+}
+
+static GstFlowReturn
+gst_g1_base_dec_setup_multibuffer (GstG1BaseDec * dec, GstVideoInfo * vinfo)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  PPOutputBuffers *config = &dec->multibuff_config;
+  GstBuffer *buffer;
+  guint32 luma, chroma;
+  GstFlowReturn ret;
+  PPResult ppret;
+  guint i, n;
+
+  gst_g1_base_dec_reset_multibuffer (dec);
+
+  /* Don't try again until the pool is renegotiated */
+  dec->multibuff_pool = gst_video_decoder_get_buffer_pool (bdec);
+
+  n = MIN (dec->multibuff_size, PP_MAX_MULTIBUFFER);
+  for (i = 0; i < n; i++) {
+    buffer = gst_g1_base_dec_new_output_buffer (dec, vinfo);
+    if (!buffer) {
+      GST_DEBUG_OBJECT (dec, "unable to allocate output buffer");
+      gst_g1_base_dec_reset_multibuffer (dec);
+      return GST_FLOW_FLUSHING;
+    }
+
+    luma = gst_g1_base_dec_buffer_address (buffer, vinfo, &chroma);
+    if (!luma) {
+      GST_CAT_INFO (GST_CAT_PERFORMANCE, "output buffers are not physically "
+          "contiguous, post processor multibuffer mode disabled");
+      gst_buffer_unref (buffer);
+      g_ptr_array_set_size (dec->multibuff, 0);
+      return GST_FLOW_OK;
+    }
+
+    g_ptr_array_add (dec->multibuff, buffer);
+    config->ppOutputBuffers[i].bufferBusAddr = luma;
+    config->ppOutputBuffers[i].bufferChromaBusAddr = chroma;
+  }
+  config->nbrOfBuffers = n;
+
+  g_mutex_lock (&dec->pp_lock);
+
+  gst_g1_base_dec_config_output (dec, vinfo);
+  for (i = 0; i < n; i++) {
+    luma = config->ppOutputBuffers[i].bufferBusAddr;
+    chroma = config->ppOutputBuffers[i].bufferChromaBusAddr;
+    config->ppOutputBuffers[i] = dec->ppconfig.ppOutImg;
+    config->ppOutputBuffers[i].bufferBusAddr = luma;
+    config->ppOutputBuffers[i].bufferChromaBusAddr = chroma;
+  }
+
+  /* The first buffer is programmed as usual, the post processor moves on
+     through the rest by itself */
+  ret = gst_g1_base_dec_commit_config (dec,
+      config->ppOutputBuffers[0].bufferBusAddr,
+      config->ppOutputBuffers[0].bufferChromaBusAddr);
+
+  g_mutex_unlock (&dec->pp_lock);
+
+  if (GST_FLOW_OK != ret) {
+    gst_g1_base_dec_reset_multibuffer (dec);
+    return ret;
+  }
+
+  ppret = PPDecSetMultipleOutput (dec->pp, config);
+  if (GST_G1_PP_FAILED (ppret)) {
+    GST_ERROR_OBJECT (dec, "unable to set multiple output buffers, %s",
+        gst_g1_result_pp (ppret));
+    gst_g1_base_dec_reset_multibuffer (dec);
+    return GST_FLOW_ERROR;
+  }
+
+  GST_INFO_OBJECT (dec, "post processing into a ring of %d buffers", n);
+
+  return GST_FLOW_OK;
+}
+
+/* Finds the ring buffer the post processor wrote the last picture into */
+static gint
+gst_g1_base_dec_next_multibuffer (GstG1BaseDec * dec)
+{
+  PPOutput output;
+  PPResult ppret;
+  guint i;
+
+  ppret = PPGetNextOutput (dec->pp, &output);
+  if (GST_G1_PP_FAILED (ppret)) {
+    GST_ERROR_OBJECT (dec, "unable to get post processor output, %s",
+        gst_g1_result_pp (ppret));
+    return -1;
+  }
+
+  for (i = 0; i < dec->multibuff->len; i++) {
+    if (dec->multibuff_config.ppOutputBuffers[i].bufferBusAddr ==
+        output.bufferBusAddr) {
+      dec->multibuff_next = (i + 1) % dec->multibuff->len;
+      return i;
+    }
+  }
+
+  GST_ERROR_OBJECT (dec, "unknown post processor output 0x%08x",
+      output.bufferBusAddr);
+  return -1;
+}
+
+static void
+gst_g1_base_dec_slot_release (gpointer data)
+{
+  GstG1BaseDecSlot *slot = data;
+  GstG1BaseDec *dec = slot->dec;
+
+  g_mutex_lock (&dec->native_lock);
+  if (dec->multibuff_held[slot->index] == slot)
+    dec->multibuff_held[slot->index] = NULL;
+  g_mutex_unlock (&dec->native_lock);
+
+  gst_buffer_unref (slot->buffer);
+  gst_object_unref (dec);
+  g_slice_free (GstG1BaseDecSlot, slot);
+}
+
+/* Hands the picture at index downstream without taking its buffer out
+   of the ring. Returns NULL for buffers that can't be wrapped */
+static GstBuffer *
+gst_g1_base_dec_wrap_multibuffer (GstG1BaseDec * dec, guint index)
+{
+  GstG1BaseDecSlot *slot;
+  GstG1Memory *g1mem;
+  GstBuffer *ring;
+  GstBuffer *buffer;
+  GstMemory *mem;
+  GstMemory *wrapped;
+
+  /* KMS buffers are scanned out from their own memory */
+  ring = g_ptr_array_index (dec->multibuff, index);
+  mem = gst_buffer_peek_memory (ring, 0);
+  if (gst_buffer_n_memory (ring) != 1 ||
+      !GST_IS_G1_ALLOCATOR (mem->allocator))
+    return NULL;
+  g1mem = (GstG1Memory *) mem;
+
+  slot = g_slice_new (GstG1BaseDecSlot);
+  slot->dec = gst_object_ref (dec);
+  slot->buffer = gst_buffer_ref (ring);
+  slot->index = index;
+
+  wrapped = gst_dwl_allocator_wrap (g1mem->virtaddress, g1mem->physaddress,
+      mem->maxsize, slot, gst_g1_base_dec_slot_release);
+  if (!wrapped) {
+    gst_g1_base_dec_slot_release (slot);
+    return NULL;
+  }
+  gst_memory_resize (wrapped, mem->offset, mem->size);
+
+  g_mutex_lock (&dec->native_lock);
+  dec->multibuff_held[index] = slot;
+  g_mutex_unlock (&dec->native_lock);
+
+  buffer = gst_buffer_new ();
+  gst_buffer_append_memory (buffer, wrapped);
+  gst_buffer_copy_into (buffer, ring, GST_BUFFER_COPY_METADATA, 0, -1);
+
+  return buffer;
+}
+
+/* Puts a new buffer in the ring at index and registers the ring again,
+   the buffer it replaces is returned in old */
+static GstFlowReturn
+gst_g1_base_dec_replace_multibuffer (GstG1BaseDec * dec, guint index,
+    GstVideoInfo * vinfo, GstBuffer ** old)
+{
+  PPOutImage *image;
+  GstBuffer *buffer;
+  guint32 luma, chroma;
+  PPResult ppret;
+
+  buffer = gst_g1_base_dec_new_output_buffer (dec, vinfo);
+  if (!buffer) {
+    GST_DEBUG_OBJECT (dec, "unable to allocate output buffer");
+    return GST_FLOW_FLUSHING;
+  }
+
+  luma = gst_g1_base_dec_buffer_address (buffer, vinfo, &chroma);
+  if (!luma) {
+    GST_ERROR_OBJECT (dec, "output buffer is not physically contiguous");
+    gst_buffer_unref (buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  g_mutex_lock (&dec->native_lock);
+  dec->multibuff_held[index] = NULL;
+  g_mutex_unlock (&dec->native_lock);
+
+  *old = g_ptr_array_index (dec->multibuff, index);
+  g_ptr_array_index (dec->multibuff, index) = buffer;
+
+  image = &dec->multibuff_config.ppOutputBuffers[index];
+  image->bufferBusAddr = luma;
+  image->bufferChromaBusAddr = chroma;
+
+  ppret = PPDecSetMultipleOutput (dec->pp, &dec->multibuff_config);
+  if (GST_G1_PP_FAILED (ppret)) {
+    GST_ERROR_OBJECT (dec, "unable to set multiple output buffers, %s",
+        gst_g1_result_pp (ppret));
+    return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* Takes the picture out of the ring. The buffer stays in the ring and
+   is written again once downstream is done with it, KMS buffers are
+   taken out and replaced instead */
+static GstFlowReturn
+gst_g1_base_dec_pop_multibuffer (GstG1BaseDec * dec)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstVideoCodecState *state;
+  GstBuffer *buffer;
+  GstFlowReturn ret;
+  gint i;
+
+  i = gst_g1_base_dec_next_multibuffer (dec);
+  if (i < 0)
+    return GST_FLOW_ERROR;
+
+  buffer = gst_g1_base_dec_wrap_multibuffer (dec, i);
+  if (buffer) {
+    gst_buffer_replace (&dec->output_buffer, NULL);
+    dec->output_buffer = buffer;
+    return GST_FLOW_OK;
+  }
+
+  state = gst_video_decoder_get_output_state (bdec);
+  ret = gst_g1_base_dec_replace_multibuffer (dec, i, &state->info, &buffer);
+  gst_video_codec_state_unref (state);
+  if (GST_FLOW_OK != ret)
+    return ret;
+
+  gst_buffer_replace (&dec->output_buffer, NULL);
+  dec->output_buffer = buffer;
+
+  return GST_FLOW_OK;
+}
+
+GstFlowReturn
+gst_g1_base_dec_allocate_output (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstG1BaseDecFrameData *fdata;
+  GstVideoCodecFrame *next;
+  GstVideoCodecState *state;
+  GstVideoInfo *vinfo;
+  GstMemory *mem;
+  GstBuffer *buffer;
+  GstBufferPool *pool;
+  guint32 luma, chroma;
+  GstFlowReturn ret;
+  GstAllocationParams params = (const GstAllocationParams) { 0 };
+  guint32 size;
+  gboolean ready;
+  gboolean bypass;
+  gboolean output_dirty;
+  gboolean held;
+
+  g_return_val_if_fail (dec, GST_FLOW_ERROR);
+
+  /* If the ppconfig hasn't been set we are not ready yet */
+  g_mutex_lock (&dec->pp_lock);
+  ready = dec->ppconfig.ppInImg.width && dec->ppconfig.ppInImg.height &&
+      dec->ppconfig.ppInImg.pixFormat;
+  g_mutex_unlock (&dec->pp_lock);
+
+  if (!ready) {
+    GST_DEBUG_OBJECT (dec,
+        "Decoder has not parsed stream headers, skipping buffer");
+    ret = GST_FLOW_OK;
+    goto exit;
+  }
+
+  state = gst_video_decoder_get_output_state (bdec);
+  vinfo = &state->info;
+
+  /* Reordered pictures are post processed long after their frame was
+     decoded, crop and blend each one with the settings of its frame */
+  next = gst_g1_base_dec_next_frame (dec, frame);
+  dec->pp_picture = next ? next->system_frame_number : 0;
+  fdata = next ? gst_video_codec_frame_get_user_data (next) : NULL;
+
+  /* Leave the post processor out if it would only copy the picture */
+  g_mutex_lock (&dec->pp_lock);
+  gst_g1_base_dec_config_roi (dec, vinfo,
+      fdata && fdata->cropped ? &fdata->crop : NULL);
+  gst_g1_base_dec_config_overlay (dec, vinfo, fdata ? fdata->overlay : NULL);
+  dec->pp_interlaced = dec->interlaced &&
+      !dec->ppconfig.ppOutDeinterlace.enable;
+  bypass = gst_g1_base_dec_can_bypass (dec, vinfo);
+  g_mutex_unlock (&dec->pp_lock);
+
+  /* Or if the picture will be dropped anyway. Switching the multibuffer
+     ring off and on would cost more than it saves */
+  dec->pp_skipped = !bypass && !dec->pp_multibuffer &&
+      gst_g1_base_dec_late (dec, frame);
+  if (dec->pp_skipped)
+    GST_CAT_DEBUG (GST_CAT_PERFORMANCE, "frame %d is late, skipping post "
+        "processing", frame->system_frame_number);
+
+  if (!gst_g1_base_dec_config_bypass (dec, bypass || dec->pp_skipped)) {
+    ret = GST_FLOW_ERROR;
+    goto stateunref;
+  }
+
+  /* Pictures out of this decode are dropped, nothing to write them to */
+  if (dec->pp_skipped) {
+    gst_buffer_replace (&dec->output_buffer, NULL);
+    ret = GST_FLOW_OK;
+    goto stateunref;
+  }
+
+  /* The codec picture is output as is, this buffer is only used if it
+   * has to be copied */
+  if (dec->pp_bypass) {
+    gst_buffer_replace (&dec->output_buffer, NULL);
+    dec->output_buffer = gst_g1_base_dec_new_output_buffer (dec, vinfo);
+    if (!dec->output_buffer) {
+      GST_DEBUG_OBJECT (dec, "unable to allocate output buffer");
+      ret = GST_FLOW_FLUSHING;
+    } else {
+      ret = GST_FLOW_OK;
+    }
+    goto stateunref;
+  }
+
+  /* The post processor cycles through the ring by itself, just point at
+   * the buffer it writes next */
+  if (dec->pp_multibuffer && dec->multibuff_size > 1) {
+    g_mutex_lock (&dec->pp_lock);
+    output_dirty = (dec->pp_dirty & PP_DIRTY_OUTPUT) != 0;
+    g_mutex_unlock (&dec->pp_lock);
+
+    pool = gst_video_decoder_get_buffer_pool (bdec);
+    if (pool != dec->multibuff_pool || output_dirty)
+      ret = gst_g1_base_dec_setup_multibuffer (dec, vinfo);
+    else
+      ret = GST_FLOW_OK;
+    if (pool)
+      gst_object_unref (pool);
+
+    if (GST_FLOW_OK != ret || !dec->multibuff->len)
+      goto single;
+
+    /* Downstream still holds the buffer written next, only then does
+     * the ring get a new one */
+    g_mutex_lock (&dec->native_lock);
+    held = dec->multibuff_held[dec->multibuff_next] != NULL;
+    g_mutex_unlock (&dec->native_lock);
+
+    if (held) {
+      GST_CAT_LOG (GST_CAT_PERFORMANCE, "downstream holds ring buffer %d, "
+          "replacing it", dec->multibuff_next);
+      ret = gst_g1_base_dec_replace_multibuffer (dec, dec->multibuff_next,
+          vinfo, &buffer);
+      if (GST_FLOW_OK != ret)
+        goto stateunref;
+      gst_buffer_unref (buffer);
+    }
+
+    /* Settings changed at runtime are picked up on the next picture,
+     * the ring stays as it is */
+    luma = dec->multibuff_config.ppOutputBuffers[dec->multibuff_next].
+        bufferBusAddr;
+    chroma = dec->multibuff_config.ppOutputBuffers[dec->multibuff_next].
+        bufferChromaBusAddr;
+
+    g_mutex_lock (&dec->pp_lock);
+    if (dec->pp_dirty)
+      ret = gst_g1_base_dec_commit_config (dec, luma, chroma);
+    g_mutex_unlock (&dec->pp_lock);
+
+    if (GST_FLOW_OK == ret)
+      gst_buffer_replace (&dec->output_buffer,
+          g_ptr_array_index (dec->multibuff, dec->multibuff_next));
+    goto stateunref;
+  }
+
+single:
+
+  /* The picture may end up in a different frame than this one, the
+   * buffer is attached to it when the picture is pushed */
+  gst_buffer_replace (&dec->output_buffer, NULL);
+
+  dec->output_buffer = gst_g1_base_dec_new_output_buffer (dec, vinfo);
+  if (!dec->output_buffer) {
+    /* Downstream is flushing or shutting down */
+    GST_DEBUG_OBJECT (dec, "unable to allocate output buffer");
+    ret = GST_FLOW_FLUSHING;
+    goto stateunref;
+  }
+
+  luma = gst_g1_base_dec_buffer_address (dec->output_buffer, vinfo, &chroma);
+  if (!luma) {
+    GST_CAT_LOG (GST_CAT_PERFORMANCE,
+        "output buffer is not physically contiguous, allocating a new one...");
+
+    params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
+
+    size = gst_g1_base_dec_output_size (vinfo);
+    mem = gst_allocator_alloc (dec->allocator, size, &params);
+    if (!mem) {
+      GST_ELEMENT_ERROR (dec, RESOURCE, NO_SPACE_LEFT,
+          ("unable to allocate memory for post processor"), (NULL));
+      ret = GST_FLOW_ERROR;
+      goto stateunref;
+    }
+
+    gst_buffer_replace_all_memory (dec->output_buffer, mem);
+    luma = gst_g1_base_dec_buffer_address (dec->output_buffer, vinfo, &chroma);
+  }
+
+  /* Most of the time only the output address changes */
+  g_mutex_lock (&dec->pp_lock);
+  if (dec->pp_dirty & PP_DIRTY_OUTPUT)
+    gst_g1_base_dec_config_output (dec, vinfo);
+  ret = gst_g1_base_dec_commit_config (dec, luma, chroma);
+  g_mutex_unlock (&dec->pp_lock);
+
+stateunref:
+  {
+    gst_video_codec_state_unref (state);
+  }
+exit:
+  {
+    return ret;
+  }
+}
+
+/* Whether the post processor reads pictures in this format */
+static gboolean
+gst_g1_base_dec_pp_input (guint32 format)
+{
+  switch (format) {
+    case PP_PIX_FMT_YCBCR_4_2_0_SEMIPLANAR:
+    case PP_PIX_FMT_YCBCR_4_2_0_PLANAR:
+    case PP_PIX_FMT_YCBCR_4_2_0_TILED:
+    case PP_PIX_FMT_YCBCR_4_2_2_INTERLEAVED:
+    case PP_PIX_FMT_YCRYCB_4_2_2_INTERLEAVED:
+    case PP_PIX_FMT_CBYCRY_4_2_2_INTERLEAVED:
+    case PP_PIX_FMT_YCBCR_4_0_0:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/* Scales the picture of a frame into a buffer for the analytics pad with
+   a standalone post processor pass. Returns NULL if there is no such
+   output or the picture can't be read back */
+static GstBuffer *
+gst_g1_base_dec_analytics_picture (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame)
+{
+  GstVideoCodecState *state;
+  GstBufferPool *pool = NULL;
+  GstBuffer *buffer = NULL;
+  GstVideoInfo vinfo;
+  GstVideoMeta *meta;
+  PPConfig config;
+  PPResult ppret;
+  GstClockTime start;
+  guint32 format, luma, chroma, outluma, outchroma;
+  guint32 width, height, inwidth, inheight, cr;
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gint stride, nplanes;
+
+  GST_OBJECT_LOCK (dec);
+  if (dec->analytics_pool) {
+    pool = gst_object_ref (dec->analytics_pool);
+    vinfo = dec->analytics_info;
+  }
+  GST_OBJECT_UNLOCK (dec);
+
+  if (!pool)
+    return NULL;
+
+  state = gst_video_decoder_get_output_state (GST_VIDEO_DECODER (dec));
+
+  /* The first pass output is read back, it has to be YCbCr */
+  format = gst_format_gst_to_g1 (state->info.finfo);
+  if (!gst_g1_base_dec_pp_input (format)) {
+    GST_DEBUG_OBJECT (dec, "no analytics output from %s pictures",
+        GST_VIDEO_INFO_NAME (&state->info));
+    goto exit;
+  }
+
+  luma = gst_g1_base_dec_buffer_address (frame->output_buffer, &state->info,
+      &chroma);
+  if (!luma) {
+    GST_DEBUG_OBJECT (dec, "picture is not physically contiguous, no "
+        "analytics output");
+    goto exit;
+  }
+
+  /* The picture is read as it was written, a downstream buffer may be
+     laid out differently from the caps */
+  meta = gst_buffer_get_video_meta (frame->output_buffer);
+  if (meta) {
+    nplanes = meta->n_planes;
+    stride = meta->stride[0];
+    memcpy (offset, meta->offset, sizeof (offset));
+  } else {
+    nplanes = GST_VIDEO_INFO_N_PLANES (&state->info);
+    stride = GST_VIDEO_INFO_PLANE_STRIDE (&state->info, 0);
+    memcpy (offset, state->info.offset, sizeof (offset));
+  }
+
+  width = GST_VIDEO_INFO_WIDTH (&state->info);
+  height = GST_VIDEO_INFO_HEIGHT (&state->info);
+  if (stride > 0) {
+    inwidth = stride / GST_VIDEO_FORMAT_INFO_PSTRIDE (state->info.finfo, 0);
+    inheight = nplanes > 1 ? (offset[1] - offset[0]) / stride :
+        GST_ROUND_UP_16 (height);
+  } else {
+    inwidth = inheight = 0;
+  }
+
+  /* The post processor reads whole macroblocks */
+  if (!inwidth || !inheight || (inwidth & 0xf) || (inheight & 0xf) ||
+      inwidth < width || inheight < height) {
+    GST_DEBUG_OBJECT (dec, "picture layout of %ux%u can't be read back, no "
+        "analytics output", inwidth, inheight);
+    goto exit;
+  }
+  cr = 3 == nplanes ? luma + offset[2] - offset[0] : 0;
+
+  if (GST_FLOW_OK != gst_buffer_pool_acquire_buffer (pool, &buffer, NULL)) {
+    GST_DEBUG_OBJECT (dec, "unable to acquire analytics buffer");
+    goto exit;
+  }
+  outluma = gst_g1_base_dec_buffer_address (buffer, &vinfo, &outchroma);
+
+  if (!dec->analytics_pp) {
+    ppret = PPInit (&dec->analytics_pp);
+    if (GST_G1_PP_FAILED (ppret)) {
+      GST_ERROR_OBJECT (dec, "Failed to open analytics post processor, %s",
+          gst_g1_result_pp (ppret));
+      dec->analytics_pp = NULL;
+      goto error;
+    }
+  }
+
+  ppret = PPGetConfig (dec->analytics_pp, &config);
+  if (GST_G1_PP_FAILED (ppret))
+    goto pperror;
+
+  config.ppInImg.pixFormat = format;
+  config.ppInImg.width = inwidth;
+  config.ppInImg.height = inheight;
+  config.ppInImg.bufferBusAddr = luma;
+  config.ppInImg.bufferCbBusAddr = chroma;
+  config.ppInImg.bufferCrBusAddr = cr;
+
+  /* Leave the padding of the layout out of the scaled picture */
+  width = MIN (GST_ROUND_UP_8 (width), inwidth);
+  height = MIN (GST_ROUND_UP_8 (height), inheight);
+  config.ppInCrop.enable = width < inwidth || height < inheight;
+  config.ppInCrop.originX = 0;
+  config.ppInCrop.originY = 0;
+  config.ppInCrop.width = width;
+  config.ppInCrop.height = height;
+
+  config.ppOutImg.pixFormat = gst_format_gst_to_g1 (vinfo.finfo);
+  config.ppOutImg.width = GST_ROUND_UP_16 (GST_VIDEO_INFO_WIDTH (&vinfo));
+  config.ppOutImg.height = GST_ROUND_UP_16 (GST_VIDEO_INFO_HEIGHT (&vinfo));
+  config.ppOutImg.bufferBusAddr = outluma;
+  config.ppOutImg.bufferChromaBusAddr = outchroma;
+  config.ppOutRgb.ditheringEnable = 1;
+
+  ppret = PPSetConfig (dec->analytics_pp, &config);
+  if (GST_G1_PP_FAILED (ppret))
+    goto pperror;
+
+  /* Standalone, the job runs when the result is asked for */
+  start = gst_util_get_timestamp ();
+  gst_g1_scheduler_acquire (dec->scheduler, GST_CLOCK_TIME_NONE);
+  ppret = PPGetResult (dec->analytics_pp);
+  gst_g1_scheduler_release (dec->scheduler);
+  gst_g1_base_dec_record (dec, GST_G1_BASE_DEC_STAGE_PP,
+      gst_util_get_timestamp () - start);
+  if (GST_G1_PP_FAILED (ppret))
+    goto pperror;
+
+  GST_BUFFER_PTS (buffer) = frame->pts;
+  GST_BUFFER_DTS (buffer) = frame->dts;
+  GST_BUFFER_DURATION (buffer) = frame->duration;
+
+exit:
+  {
+    gst_video_codec_state_unref (state);
+    gst_object_unref (pool);
+    return buffer;
+  }
+pperror:
+  {
+    GST_ERROR_OBJECT (dec, "analytics post processing failed, %s",
+        gst_g1_result_pp (ppret));
+  }
+error:
+  {
+    gst_buffer_unref (buffer);
+    buffer = NULL;
+    goto exit;
+  }
+}
+
+/* Drops a frame whose picture wasn't post processed */
+static GstFlowReturn
+gst_g1_base_dec_drop_data (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GST_DEBUG_OBJECT (dec, "dropping late frame %d",
+      frame->system_frame_number);
+  gst_g1_base_dec_count (dec, GST_G1_BASE_DEC_SKIPPED_PICTURES, 1);
+
+  gst_video_codec_frame_ref (frame);
+
+  /* Running in the worker thread, the streaming thread drops it */
+  if (dec->worker) {
+    g_mutex_lock (&dec->async_lock);
+    if (dec->flushing)
+      gst_video_codec_frame_unref (frame);
+    else
+      gst_g1_base_dec_queue_output (dec, frame, FALSE, NULL);
+    g_mutex_unlock (&dec->async_lock);
+    return GST_FLOW_OK;
+  }
+
+  return gst_video_decoder_drop_frame (GST_VIDEO_DECODER (dec), frame);
+}
+
+GstFlowReturn
+gst_g1_base_dec_push_data (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstBuffer *analytics;
+  GstClockTime start;
+  GstFlowReturn ret;
+  PPResult ppret;
+
+  g_return_val_if_fail (dec, GST_FLOW_ERROR);
+  g_return_val_if_fail (frame, GST_FLOW_ERROR);
+
+  if (dec->pp_skipped) {
+    ret = gst_g1_base_dec_drop_data (dec, frame);
+    goto exit;
+  }
+
+  g_return_val_if_fail (dec->output_buffer, GST_FLOW_ERROR);
+
+  start = gst_util_get_timestamp ();
+  ppret = dec->pp_bypass ? PP_OK : PPGetResult (dec->pp);
+  if (!dec->pp_bypass)
+    gst_g1_base_dec_record (dec, GST_G1_BASE_DEC_STAGE_PP,
+        gst_util_get_timestamp () - start);
+  if (GST_G1_PP_FAILED (ppret)) {
+    GST_ERROR_OBJECT (dec, "%s", gst_g1_result_pp (ppret));
+    ret = GST_FLOW_ERROR;
+    goto exit;
+  }
+
+  if (dec->multibuff->len) {
+    ret = gst_g1_base_dec_pop_multibuffer (dec);
+    if (GST_FLOW_OK != ret)
+      goto exit;
+  }
+
+  /* The picture belongs to this frame, the next one needs a new buffer */
+  gst_buffer_replace (&frame->output_buffer, NULL);
+  frame->output_buffer = dec->output_buffer;
+  dec->output_buffer = NULL;
+
+  analytics = gst_g1_base_dec_analytics_picture (dec, frame);
+
+  gst_video_codec_frame_ref (frame);
+
+  /* Running in the worker thread, the streaming thread pushes it */
+  if (dec->worker) {
+    g_mutex_lock (&dec->async_lock);
+    if (dec->flushing) {
+      gst_video_codec_frame_unref (frame);
+      if (analytics)
+        gst_buffer_unref (analytics);
+    } else {
+      gst_g1_base_dec_queue_output (dec, frame, TRUE, analytics);
+    }
+    g_mutex_unlock (&dec->async_lock);
+    ret = GST_FLOW_OK;
+    goto exit;
+  }
+
+  if (analytics)
+    gst_g1_base_dec_push_analytics (dec, analytics);
+
+  gst_g1_base_dec_output_interlace (dec, dec->pp_interlaced);
+  start = gst_util_get_timestamp ();
+  ret = gst_video_decoder_finish_frame (bdec, frame);
+  gst_g1_base_dec_record (dec, GST_G1_BASE_DEC_STAGE_PUSH,
+      gst_util_get_timestamp () - start);
+
+exit:
+  {
+    return ret;
+  }
+}
+
+static void
+gst_g1_base_dec_native_release (gpointer data)
+{
+  GstG1BaseDecNative *native = data;
+  GstG1BaseDec *dec = native->dec;
+
+  g_mutex_lock (&dec->native_lock);
+  g_hash_table_remove (dec->native_pictures, native->virtaddress);
+  g_cond_broadcast (&dec->native_cond);
+  g_mutex_unlock (&dec->native_lock);
+
+  gst_object_unref (dec);
+  g_slice_free (GstG1BaseDecNative, native);
+}
+
+/* Whether the codec may overwrite a held picture once it decodes again,
+   it only leaves the last native_max pictures output alone. Must be
+   called with the native lock held */
+static gboolean
+gst_g1_base_dec_native_unsafe (GstG1BaseDec * dec, guint outputs)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, dec->native_pictures);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    if (outputs - GPOINTER_TO_UINT (value) >= dec->native_max)
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Blocks until downstream returns the pictures the codec is about to
+   overwrite, or all of them before the codec frees its pictures */
+static void
+gst_g1_base_dec_native_wait (GstG1BaseDec * dec, gboolean all)
+{
+  g_mutex_lock (&dec->native_lock);
+
+  while (g_hash_table_size (dec->native_pictures) &&
+      (all || (!dec->native_flushing &&
+              gst_g1_base_dec_native_unsafe (dec, dec->native_outputs)))) {
+    GST_DEBUG_OBJECT (dec, "waiting for downstream to return %d pictures",
+        g_hash_table_size (dec->native_pictures));
+    g_cond_wait (&dec->native_cond, &dec->native_lock);
+  }
+
+  g_mutex_unlock (&dec->native_lock);
+}
+
+/* Wraps a codec picture in a buffer, the codec is told nothing but it
+   leaves the last native_max pictures alone, and isn't let decode again
+   while downstream holds an older one */
+static GstBuffer *
+gst_g1_base_dec_wrap_picture (GstG1BaseDec * dec, gpointer virtaddress,
+    guint32 physaddress, gsize size)
+{
+  GstVideoCodecState *state;
+  GstVideoInfo aligned;
+  GstG1BaseDecNative *native;
+  GstBuffer *buffer;
+  GstMemory *mem;
+
+  native = g_slice_new (GstG1BaseDecNative);
+  native->dec = gst_object_ref (dec);
+  native->virtaddress = virtaddress;
+
+  /* Tracked before it can be released, it is the next picture out */
+  g_mutex_lock (&dec->native_lock);
+  g_hash_table_insert (dec->native_pictures, virtaddress,
+      GUINT_TO_POINTER (dec->native_outputs + 1));
+  g_mutex_unlock (&dec->native_lock);
+
+  mem = gst_dwl_allocator_wrap (virtaddress, physaddress, size, native,
+      gst_g1_base_dec_native_release);
+  if (!mem) {
+    gst_g1_base_dec_native_release (native);
+    return NULL;
+  }
+
+  buffer = gst_buffer_new ();
+  gst_buffer_append_memory (buffer, mem);
+
+  state = gst_video_decoder_get_output_state (GST_VIDEO_DECODER (dec));
+  aligned = state->info;
+  gst_video_codec_state_unref (state);
+
+  gst_format_g1_align (&aligned);
+  gst_buffer_add_video_meta_full (buffer, GST_VIDEO_FRAME_FLAG_NONE,
+      GST_VIDEO_INFO_FORMAT (&aligned), GST_VIDEO_INFO_WIDTH (&aligned),
+      GST_VIDEO_INFO_HEIGHT (&aligned), GST_VIDEO_INFO_N_PLANES (&aligned),
+      aligned.offset, aligned.stride);
+
+  return buffer;
+}
+
+void
+gst_g1_base_dec_native_picture (GstG1BaseDec * dec, gpointer virtaddress,
+    guint32 physaddress)
+{
+  GstMemory *mem;
+  GstBuffer *buffer;
+  gboolean wrap;
+  guint held;
+  gsize size;
+
+  g_return_if_fail (dec);
+  g_return_if_fail (dec->pp_bypass);
+
+  if (!dec->output_buffer)
+    return;
+
+  /* The codec writes 4:2:0 pictures in whole macroblocks */
+  g_mutex_lock (&dec->pp_lock);
+  size = GST_ROUND_UP_16 (dec->ppconfig.ppInImg.width) *
+      GST_ROUND_UP_16 (dec->ppconfig.ppInImg.height) * 3 / 2;
+  g_mutex_unlock (&dec->pp_lock);
+
+  /* Stop wrapping while a held picture would become one the codec may
+     overwrite once this one is out, it would have to wait for it */
+  g_mutex_lock (&dec->native_lock);
+  held = g_hash_table_size (dec->native_pictures);
+  wrap = dec->native_max &&
+      !gst_g1_base_dec_native_unsafe (dec, dec->native_outputs + 1);
+  g_mutex_unlock (&dec->native_lock);
+
+  /* KMS buffers are scanned out from their own memory */
+  mem = gst_buffer_peek_memory (dec->output_buffer, 0);
+  if (GST_IS_G1_ALLOCATOR (mem->allocator) && wrap) {
+    buffer = gst_g1_base_dec_wrap_picture (dec, virtaddress, physaddress,
+        size);
+    if (buffer) {
+      gst_buffer_replace (&dec->output_buffer, NULL);
+      dec->output_buffer = buffer;
+      return;
+    }
+  }
+
+  GST_CAT_LOG (GST_CAT_PERFORMANCE, "downstream holds %d pictures, copying "
+      "picture...", held);
+
+  if (size > gst_buffer_get_size (dec->output_buffer)) {
+    GST_WARNING_OBJECT (dec, "picture of %" G_GSIZE_FORMAT " bytes doesn't "
+        "fit in the output buffer", size);
+    size = gst_buffer_get_size (dec->output_buffer);
+  }
+
+  gst_buffer_fill (dec->output_buffer, 0, virtaddress, size);
+}
+
+gboolean
+gst_g1_base_dec_late (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GstClockTimeDiff deadline;
+  gboolean qos;
+
+  g_return_val_if_fail (dec, FALSE);
+
+  if (!frame)
+    return FALSE;
+
+  GST_OBJECT_LOCK (dec);
+  qos = dec->qos;
+  GST_OBJECT_UNLOCK (dec);
+
+  if (!qos)
+    return FALSE;
+
+  /* Negative once QoS reports the frame can't make it on time */
+  deadline = gst_video_decoder_get_max_decode_time (GST_VIDEO_DECODER (dec),
+      frame);
+
+  return deadline < 0;
+}
+
+gboolean
+gst_g1_base_dec_skip_non_reference (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame)
+{
+  g_return_val_if_fail (dec, FALSE);
+
+  /* Trick modes only display a fraction of the frames anyway */
+  return dec->trick_mode || gst_g1_base_dec_late (dec, frame);
+}
+
+void
+gst_g1_base_dec_hw_acquire (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  GstClockTime deadline = GST_CLOCK_TIME_NONE;
+
+  g_return_if_fail (dec);
+  g_return_if_fail (dec->scheduler);
+
+  /* The frame deadline is the running time of its PTS, make it
+     comparable with other pipelines */
+  if (frame && GST_CLOCK_TIME_IS_VALID (frame->deadline))
+    deadline = gst_element_get_base_time (GST_ELEMENT (dec)) +
+        frame->deadline;
+
+  gst_g1_scheduler_acquire (dec->scheduler, deadline);
+  dec->hw_start = gst_util_get_timestamp ();
+}
+
+void
+gst_g1_base_dec_hw_release (GstG1BaseDec * dec)
+{
+  g_return_if_fail (dec);
+  g_return_if_fail (dec->scheduler);
+
+  /* A frame may take several calls, they are summed up until it is done */
+  dec->frame_decode_time += gst_util_get_timestamp () - dec->hw_start;
+  gst_g1_scheduler_release (dec->scheduler);
+}
+
+void
+gst_g1_base_dec_count (GstG1BaseDec * dec, GstG1BaseDecCounter counter,
+    guint64 value)
+{
+  g_return_if_fail (dec);
+  g_return_if_fail (counter < GST_G1_BASE_DEC_N_COUNTERS);
+
+  GST_OBJECT_LOCK (dec);
+  dec->stats_counters[counter] += value;
+  GST_OBJECT_UNLOCK (dec);
+}
+
+/* Must be called with the object lock held */
+static void
+gst_g1_base_dec_reset_stats (GstG1BaseDec * dec)
+{
+  memset (dec->stats_histogram, 0, sizeof (dec->stats_histogram));
+  memset (dec->stats_time, 0, sizeof (dec->stats_time));
+  memset (dec->stats_counters, 0, sizeof (dec->stats_counters));
+  dec->stats_frames = 0;
+  dec->stats_posted = GST_CLOCK_TIME_NONE;
+  dec->frame_decode_time = 0;
+  dec->hw_start = GST_CLOCK_TIME_NONE;
+}
+
+static void
+gst_g1_base_dec_record (GstG1BaseDec * dec, GstG1BaseDecStage stage,
+    GstClockTime elapsed)
+{
+  guint bucket;
+
+  for (bucket = 0; bucket < G_N_ELEMENTS (stats_bounds); bucket++)
+    if (elapsed < stats_bounds[bucket])
+      break;
+
+  GST_OBJECT_LOCK (dec);
+  dec->stats_histogram[stage][bucket]++;
+  dec->stats_time[stage] += elapsed;
+  GST_OBJECT_UNLOCK (dec);
+}
 
-  /* If the ppconfig hasn't been set we are not ready yet */
-  if (!dec->ppconfig.ppInImg.width || !dec->ppconfig.ppInImg.height ||
-      !dec->ppconfig.ppInImg.pixFormat) {
-    GST_DEBUG_OBJECT (dec,
-        "Decoder has not parsed stream headers, skipping buffer");
-    ret = GST_FLOW_OK;
-    goto exit;
-  }
+static void
+gst_g1_base_dec_stats_array (GstStructure * stats, const gchar * name,
+    const guint64 * values, guint n)
+{
+  GValue array = G_VALUE_INIT;
+  GValue value = G_VALUE_INIT;
+  guint i;
 
-  state = gst_video_decoder_get_output_state (bdec);
-  vinfo = &state->info;
-  finfo = vinfo->finfo;
+  g_value_init (&array, GST_TYPE_ARRAY);
+  g_value_init (&value, G_TYPE_UINT64);
 
-  if (frame->output_buffer) {
-    gst_buffer_unref (frame->output_buffer);
-    frame->output_buffer = NULL;
+  for (i = 0; i < n; i++) {
+    g_value_set_uint64 (&value, values[i]);
+    gst_value_array_append_value (&array, &value);
   }
 
-  ret = gst_video_decoder_allocate_output_frame (bdec, frame);
-  if (GST_FLOW_OK != ret) {
-    GST_ELEMENT_ERROR (dec, RESOURCE, NO_SPACE_LEFT,
-        ("unable to allocate memory for post processor"), (NULL));
-    goto stateunref;
-  }
+  g_value_unset (&value);
+  gst_structure_take_value (stats, name, &array);
+}
 
-  /* Width and Height of the video overlay taken from user */
+static GstStructure *
+gst_g1_base_dec_stats (GstG1BaseDec * dec)
+{
+  GstStructure *stats;
+  GstClockTime hwtime;
+  gchar *name;
+  guint i;
 
-  dec->ppconfig.ppOutFrmBuffer.enable = 0;
-  dec->ppconfig.ppOutFrmBuffer.writeOriginX = dec->x;
-  dec->ppconfig.ppOutFrmBuffer.writeOriginY = dec->y;
-  dec->ppconfig.ppOutFrmBuffer.frameBufferWidth =
-      (divRoundClosest (dec->w, 16) * 16);
-  dec->ppconfig.ppOutFrmBuffer.frameBufferHeight =
-      (divRoundClosest (dec->h, 16) * 16);
+  hwtime = dec->scheduler ?
+      gst_g1_scheduler_get_busy_time (dec->scheduler, NULL) : 0;
 
-  dec->ppconfig.ppOutImg.width =
-      (divRoundClosest (GST_VIDEO_INFO_WIDTH (vinfo), 16) * 16);
-  dec->ppconfig.ppOutImg.height =
-      (divRoundClosest (GST_VIDEO_INFO_HEIGHT (vinfo), 16) * 16);
+  stats = gst_structure_new ("g1-stats",
+      "hardware-time", G_TYPE_UINT64, hwtime, NULL);
 
-  dec->ppconfig.ppOutImg.pixFormat = gst_format_gst_to_g1 (finfo);
-  dec->ppconfig.ppOutRgb.ditheringEnable = 1;
+  gst_g1_base_dec_stats_array (stats, "bucket-bounds", stats_bounds,
+      G_N_ELEMENTS (stats_bounds));
 
-  /*
-   * If it is g1kmssink and zero-copy is enabled, then post processing
-   * module copies the video frames directly to the frame buffer.
-   * Get physical address of a framebuffer
-   */
-  kmsmem = (GstKMSMemory *) gst_buffer_get_all_memory (frame->output_buffer);
-  if (kmsmem) {
-    physaddress = kmsmem->fb_phys_addr;
-    gst_memory_unref (kmsmem);
-  }
+  GST_OBJECT_LOCK (dec);
 
-  if (!physaddress) {
-    params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
+  gst_structure_set (stats, "frames", G_TYPE_UINT64, dec->stats_frames,
+      NULL);
 
-    size = dec->ppconfig.ppOutImg.width * dec->ppconfig.ppOutImg.height * 4;
-    mem = gst_allocator_alloc (dec->allocator, size, &params);
+  for (i = 0; i < GST_G1_BASE_DEC_N_COUNTERS; i++)
+    gst_structure_set (stats, stats_counters[i], G_TYPE_UINT64,
+        dec->stats_counters[i], NULL);
 
-    if (!gst_memory_map (mem, &minfo, GST_MAP_WRITE)) {
-      GST_ERROR_OBJECT (dec, "unable to map dst memory");
-      goto stateunref;
-    }
+  for (i = 0; i < GST_G1_BASE_DEC_N_STAGES; i++) {
+    name = g_strdup_printf ("%s-time", stats_stages[i]);
+    gst_structure_set (stats, name, G_TYPE_UINT64, dec->stats_time[i], NULL);
+    g_free (name);
 
-    physaddress = gst_g1_allocator_get_physical (minfo.memory);
+    name = g_strdup_printf ("%s-histogram", stats_stages[i]);
+    gst_g1_base_dec_stats_array (stats, name, dec->stats_histogram[i],
+        GST_G1_BASE_DEC_STATS_BUCKETS);
+    g_free (name);
+  }
 
-    gst_memory_unmap (mem, &minfo);
+  GST_OBJECT_UNLOCK (dec);
 
-    gst_buffer_replace_all_memory (frame->output_buffer, (GstMemory *) mem);
-  }
+  return stats;
+}
 
-  GST_LOG_OBJECT (dec, "physical address for PP 0x%08x", physaddress);
-  dec->ppconfig.ppOutImg.bufferBusAddr = physaddress +
-      GST_VIDEO_INFO_PLANE_OFFSET (vinfo, Y);
-  dec->ppconfig.ppOutImg.bufferChromaBusAddr =
-      dec->ppconfig.ppOutImg.bufferBusAddr +
-      GST_VIDEO_INFO_PLANE_OFFSET (vinfo, CbCr);
+/* Accounts for a frame the hardware is done with, and posts the stats
+   if it is time to */
+static void
+gst_g1_base_dec_frame_stats (GstG1BaseDec * dec)
+{
+  GstClockTime now;
+  gboolean post;
 
-  ppret = PPSetConfig (dec->pp, &dec->ppconfig);
-  if (GST_G1_PP_FAILED (ppret)) {
-    GST_ERROR_OBJECT (dec, "%s", gst_g1_result_pp (ppret));
-    ret = GST_FLOW_ERROR;
-    GST_ERROR_OBJECT (dec, "ppsetconfig failed =%s\n",
-        gst_g1_result_pp (ppret));
-    goto memunref;
+  if (dec->frame_decode_time) {
+    gst_g1_base_dec_record (dec, GST_G1_BASE_DEC_STAGE_DECODE,
+        dec->frame_decode_time);
+    dec->frame_decode_time = 0;
   }
 
-  return GST_FLOW_OK;
+  now = gst_util_get_timestamp ();
+
+  GST_OBJECT_LOCK (dec);
+  dec->stats_frames++;
+  if (!GST_CLOCK_TIME_IS_VALID (dec->stats_posted))
+    dec->stats_posted = now;
+  post = dec->stats_interval &&
+      now - dec->stats_posted >= dec->stats_interval * GST_MSECOND;
+  if (post)
+    dec->stats_posted = now;
+  GST_OBJECT_UNLOCK (dec);
+
+  if (post)
+    gst_element_post_message (GST_ELEMENT (dec),
+        gst_message_new_element (GST_OBJECT (dec),
+            gst_g1_base_dec_stats (dec)));
+}
 
-memunref:
-  {
-    if (!kmsmem)
-      gst_allocator_free (dec->allocator, mem);
-  }
-stateunref:
-  {
-    gst_video_codec_state_unref (state);
-  }
-exit:
-  {
-    return ret;
+/* Leaves the post processor out of the pictures coming out of the codec
+   until called again with skip unset, they are discarded without an
+   output buffer. The next picture allocated chains it again if needed */
+gboolean
+gst_g1_base_dec_skip_pictures (GstG1BaseDec * dec, gboolean skip)
+{
+  g_return_val_if_fail (dec, FALSE);
+
+  if (skip && !gst_g1_base_dec_config_bypass (dec, TRUE))
+    return FALSE;
+
+  dec->pp_skipped = skip;
+
+  return TRUE;
+}
+
+void
+gst_g1_base_dec_discard_picture (GstG1BaseDec * dec)
+{
+  g_return_if_fail (dec);
+
+  /* Keep the ring in step with the post processor, the buffer stays in
+     it to be written again */
+  if (dec->multibuff->len) {
+    PPGetResult (dec->pp);
+    gst_g1_base_dec_next_multibuffer (dec);
   }
 }
 
+void
+gst_g1_base_dec_queue_picture (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+{
+  g_return_if_fail (dec);
+  g_return_if_fail (frame);
+
+  GST_LOG_OBJECT (dec, "picture %d decoded", frame->system_frame_number);
+
+  g_hash_table_insert (dec->pictures,
+      GUINT_TO_POINTER (frame->system_frame_number),
+      gst_video_codec_frame_ref (frame));
+}
+
 GstFlowReturn
-gst_g1_base_dec_push_data (GstG1BaseDec * dec, GstVideoCodecFrame * frame)
+gst_g1_base_dec_push_picture (GstG1BaseDec * dec, guint32 picid)
 {
-  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstVideoCodecFrame *frame;
   GstFlowReturn ret;
-  PPResult ppret;
 
   g_return_val_if_fail (dec, GST_FLOW_ERROR);
-  g_return_val_if_fail (frame, GST_FLOW_ERROR);
-  g_return_val_if_fail (frame->output_buffer, GST_FLOW_ERROR);
 
-  ppret = PPGetResult (dec->pp);
-  if (GST_G1_PP_FAILED (ppret)) {
-    GST_ERROR_OBJECT (dec, "%s", gst_g1_result_pp (ppret));
-    ret = GST_FLOW_ERROR;
-    goto exit;
+  /* Output or not, the codec counts the picture as the last one out */
+  g_mutex_lock (&dec->native_lock);
+  dec->native_outputs++;
+  g_mutex_unlock (&dec->native_lock);
+
+  frame = g_hash_table_lookup (dec->pictures, GUINT_TO_POINTER (picid));
+  if (!frame) {
+    GST_DEBUG_OBJECT (dec, "no frame for picture %d, discarding it", picid);
+    gst_g1_base_dec_discard_picture (dec);
+    return GST_FLOW_OK;
   }
 
-  gst_video_codec_frame_ref (frame);
-  ret = gst_video_decoder_finish_frame (bdec, frame);
+  /* Take over the reference held by the table */
+  g_hash_table_steal (dec->pictures, GUINT_TO_POINTER (picid));
 
-exit:
-  {
-    return ret;
-  }
+  GST_LOG_OBJECT (dec, "picture %d ready", picid);
+
+  if (picid != dec->pp_picture)
+    GST_DEBUG_OBJECT (dec, "picture %d was post processed with the settings "
+        "of picture %d", picid, dec->pp_picture);
+
+  ret = gst_g1_base_dec_push_data (dec, frame);
+  gst_video_codec_frame_unref (frame);
+
+  return ret;
 }
 
 static void
@@ -812,11 +4109,19 @@ gst_g1_base_dec_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
   GstG1BaseDec *g1dec = GST_G1_BASE_DEC (object);
+  gboolean load_mask1 = FALSE;
+
+  /* The streaming thread picks the changes up on the next picture */
+  g_mutex_lock (&g1dec->pp_lock);
 
   switch (prop_id) {
-    PROP_ROTATION:
+    case PROP_ROTATION:
       gst_g1_base_dec_config_rotation (g1dec, g_value_get_enum (value));
       break;
+    case PROP_DEINTERLACE:
+      g1dec->deinterlace = g_value_get_enum (value);
+      gst_g1_base_dec_config_deinterlace (g1dec);
+      break;
     case PROP_BRIGHTNESS:
       gst_g1_base_dec_config_brightness (g1dec, g_value_get_int (value));
       break;
@@ -842,9 +4147,16 @@ gst_g1_base_dec_set_property (GObject * object, guint prop_id,
       gst_g1_base_dec_config_crop (g1dec, -1, -1, -1,
           (gint) g_value_get_uint (value));
       break;
+    case PROP_ROI_CROP:
+      g1dec->roi_crop = g_value_get_boolean (value);
+      break;
+    case PROP_ROI_TYPE:
+      g_free (g1dec->roi_type);
+      g1dec->roi_type = g_value_dup_string (value);
+      break;
     case PROP_MASK1_LOCATION:
-      gst_g1_base_dec_config_mask1 (g1dec, g_value_get_string (value),
-          -1, -1, -1, -1);
+      load_mask1 = gst_g1_base_dec_config_mask1 (g1dec,
+          g_value_get_string (value), -1, -1, -1, -1);
       break;
     case PROP_MASK1_X:
       gst_g1_base_dec_config_mask1 (g1dec, (gpointer) - 1,
@@ -855,31 +4167,78 @@ gst_g1_base_dec_set_property (GObject * object, guint prop_id,
           -1, (gint) g_value_get_uint (value), -1, -1);
       break;
     case PROP_MASK1_WIDTH:
-      gst_g1_base_dec_config_mask1 (g1dec, (gpointer) - 1,
+      load_mask1 = gst_g1_base_dec_config_mask1 (g1dec, (gpointer) - 1,
           -1, -1, (gint) g_value_get_uint (value), -1);
       break;
     case PROP_MASK1_HEIGHT:
-      gst_g1_base_dec_config_mask1 (g1dec, (gpointer) - 1,
+      load_mask1 = gst_g1_base_dec_config_mask1 (g1dec, (gpointer) - 1,
           -1, -1, -1, (gint) g_value_get_uint (value));
       break;
     case PROP_X:
       g1dec->x = (gint) g_value_get_uint (value);
+      g1dec->pp_dirty |= PP_DIRTY_OUTPUT;
       break;
     case PROP_Y:
       g1dec->y = (gint) g_value_get_uint (value);
+      g1dec->pp_dirty |= PP_DIRTY_OUTPUT;
       break;
     case PROP_W:
       g1dec->w = (gint) g_value_get_uint (value);
+      g1dec->pp_dirty |= PP_DIRTY_OUTPUT;
       break;
     case PROP_H:
       g1dec->h = (gint) g_value_get_uint (value);
+      g1dec->pp_dirty |= PP_DIRTY_OUTPUT;
+      break;
+    case PROP_INPUT_RING_SIZE:
+      GST_OBJECT_LOCK (g1dec);
+      g1dec->input_ring_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (g1dec);
+      break;
+    case PROP_ASYNC_DECODE:
+      g1dec->async_decode = g_value_get_boolean (value);
+      break;
+    case PROP_PP_MULTIBUFFER:
+      g1dec->pp_multibuffer = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_WIDTH:
+      g1dec->max_width = g_value_get_uint (value);
+      break;
+    case PROP_MAX_HEIGHT:
+      g1dec->max_height = g_value_get_uint (value);
+      break;
+    case PROP_QOS:
+      GST_OBJECT_LOCK (g1dec);
+      g1dec->qos = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (g1dec);
+      break;
+    case PROP_STATS_INTERVAL:
+      GST_OBJECT_LOCK (g1dec);
+      g1dec->stats_interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (g1dec);
+      break;
+    case PROP_PRIORITY:
+      g1dec->priority = g_value_get_int (value);
+      if (g1dec->scheduler)
+        gst_g1_scheduler_configure (g1dec->scheduler, g1dec->scheduling,
+            g1dec->priority);
+      break;
+    case PROP_SCHEDULING:
+      g1dec->scheduling = g_value_get_enum (value);
+      if (g1dec->scheduler)
+        gst_g1_scheduler_configure (g1dec->scheduler, g1dec->scheduling,
+            g1dec->priority);
       break;
-
-
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+
+  g_mutex_unlock (&g1dec->pp_lock);
+
+  /* The mask file is read without holding up the streaming thread */
+  if (load_mask1)
+    gst_g1_base_dec_load_mask1 (g1dec);
 }
 
 static void
@@ -888,10 +4247,15 @@ gst_g1_base_dec_get_property (GObject * object, guint prop_id,
 {
   GstG1BaseDec *g1dec = GST_G1_BASE_DEC (object);
 
+  g_mutex_lock (&g1dec->pp_lock);
+
   switch (prop_id) {
     case PROP_ROTATION:
       g_value_set_enum (value, g1dec->rotation);
       break;
+    case PROP_DEINTERLACE:
+      g_value_set_enum (value, g1dec->deinterlace);
+      break;
     case PROP_BRIGHTNESS:
       g_value_set_int (value, g1dec->brightness);
       break;
@@ -913,6 +4277,12 @@ gst_g1_base_dec_get_property (GObject * object, guint prop_id,
     case PROP_CROP_HEIGHT:
       g_value_set_uint (value, g1dec->crop_height);
       break;
+    case PROP_ROI_CROP:
+      g_value_set_boolean (value, g1dec->roi_crop);
+      break;
+    case PROP_ROI_TYPE:
+      g_value_set_string (value, g1dec->roi_type);
+      break;
     case PROP_X:
       g_value_set_uint (value, g1dec->x);
       break;
@@ -920,10 +4290,10 @@ gst_g1_base_dec_get_property (GObject * object, guint prop_id,
       g_value_set_uint (value, g1dec->y);
       break;
     case PROP_W:
-      g_value_set_uint (value, g1dec->x);
+      g_value_set_uint (value, g1dec->w);
       break;
     case PROP_H:
-      g_value_set_uint (value, g1dec->y);
+      g_value_set_uint (value, g1dec->h);
       break;
     case PROP_MASK1_LOCATION:
       g_value_set_string (value, g1dec->mask1_location);
@@ -940,10 +4310,52 @@ gst_g1_base_dec_get_property (GObject * object, guint prop_id,
     case PROP_MASK1_HEIGHT:
       g_value_set_uint (value, g1dec->mask1_height);
       break;
+    case PROP_INPUT_RING_SIZE:
+      GST_OBJECT_LOCK (g1dec);
+      g_value_set_uint (value, g1dec->input_ring_size);
+      GST_OBJECT_UNLOCK (g1dec);
+      break;
+    case PROP_ASYNC_DECODE:
+      g_value_set_boolean (value, g1dec->async_decode);
+      break;
+    case PROP_PP_MULTIBUFFER:
+      g_value_set_boolean (value, g1dec->pp_multibuffer);
+      break;
+    case PROP_MAX_WIDTH:
+      g_value_set_uint (value, g1dec->max_width);
+      break;
+    case PROP_MAX_HEIGHT:
+      g_value_set_uint (value, g1dec->max_height);
+      break;
+    case PROP_QOS:
+      GST_OBJECT_LOCK (g1dec);
+      g_value_set_boolean (value, g1dec->qos);
+      GST_OBJECT_UNLOCK (g1dec);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_g1_base_dec_stats (g1dec));
+      break;
+    case PROP_STATS_INTERVAL:
+      GST_OBJECT_LOCK (g1dec);
+      g_value_set_uint (value, g1dec->stats_interval);
+      GST_OBJECT_UNLOCK (g1dec);
+      break;
+    case PROP_PRIORITY:
+      g_value_set_int (value, g1dec->priority);
+      break;
+    case PROP_SCHEDULING:
+      g_value_set_enum (value, g1dec->scheduling);
+      break;
+    case PROP_HARDWARE_TIME:
+      g_value_set_uint64 (value, g1dec->scheduler ?
+          gst_g1_scheduler_get_busy_time (g1dec->scheduler, NULL) : 0);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+
+  g_mutex_unlock (&g1dec->pp_lock);
 }
 
 static gboolean
@@ -975,17 +4387,235 @@ exit:
   }
 }
 
+/* Pictures of the old size go out with the old configuration */
+static void
+gst_g1_base_dec_resize_drain (GstG1BaseDec * dec)
+{
+  GstG1BaseDecClass *g1decclass;
+
+  g1decclass = GST_G1_BASE_DEC_CLASS (G_OBJECT_GET_CLASS (dec));
+
+  if (g_hash_table_size (dec->pictures) && g1decclass->drain)
+    g1decclass->drain (dec);
+}
+
+/* Makes the output follow the stream size, once the pictures of the old
+   size are out. Must be called from the streaming thread */
+static void
+gst_g1_base_dec_resize_output (GstG1BaseDec * dec, gboolean resized,
+    gint32 width, gint32 height)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstVideoCodecState *state;
+  GstVideoCodecState *newstate;
+  guint held;
+
+  /* The codec frees its pictures of the old size, have downstream
+     return the ones it holds first */
+  if (resized) {
+    g_mutex_lock (&dec->native_lock);
+    held = g_hash_table_size (dec->native_pictures);
+    g_mutex_unlock (&dec->native_lock);
+
+    if (held) {
+#if GST_CHECK_VERSION(1,2,0)
+      GstQuery *query = gst_query_new_drain ();
+      gst_pad_peer_query (GST_VIDEO_DECODER_SRC_PAD (dec), query);
+      gst_query_unref (query);
+#endif
+      gst_g1_base_dec_native_wait (dec, TRUE);
+    }
+  }
+
+  /* Otherwise downstream asked for a fixed size and the post processor
+     keeps scaling into it */
+  if (!dec->follow_input)
+    return;
+
+  state = gst_video_decoder_get_output_state (bdec);
+  if (!state)
+    return;
+
+  if (GST_VIDEO_INFO_WIDTH (&state->info) != width ||
+      GST_VIDEO_INFO_HEIGHT (&state->info) != height) {
+    /* The rest of the format is kept */
+    newstate = gst_video_decoder_set_output_state (bdec,
+        GST_VIDEO_INFO_FORMAT (&state->info), width, height, state);
+    gst_video_codec_state_unref (newstate);
+
+    /* Cropping is checked against the new size by the caller */
+    g_mutex_lock (&dec->pp_lock);
+    dec->out_width = width;
+    dec->out_height = height;
+    g_mutex_unlock (&dec->pp_lock);
+
+    /* The worker takes buffers from the pool without negotiating */
+    if (!gst_video_decoder_negotiate (bdec)) {
+      GST_WARNING_OBJECT (dec, "unable to negotiate %dx%d output", width,
+          height);
+      gst_pad_mark_reconfigure (GST_VIDEO_DECODER_SRC_PAD (dec));
+    }
+  }
+
+  gst_video_codec_state_unref (state);
+}
+
 void
-gst_g1_base_dec_config_format (GstG1BaseDec * dec, GstVideoFormatInfo * fmt,
+gst_g1_base_dec_config_format (GstG1BaseDec * dec, guint32 fmt,
     gint32 width, gint32 height)
 {
-  dec->ppconfig.ppInImg.pixFormat = gst_format_gst_to_g1 (fmt);
+  gboolean resized;
+
+  g_mutex_lock (&dec->pp_lock);
+
+  /* Same geometry, the post processor input is programmed already */
+  if (dec->ppconfig.ppInImg.pixFormat == gst_format_g1_to_pp (fmt) &&
+      dec->ppconfig.ppInImg.width == width &&
+      dec->ppconfig.ppInImg.height == height) {
+    g_mutex_unlock (&dec->pp_lock);
+    return;
+  }
+
+  resized = dec->ppconfig.ppInImg.width && dec->ppconfig.ppInImg.height &&
+      (dec->ppconfig.ppInImg.width != width ||
+      dec->ppconfig.ppInImg.height != height);
+
+  if (resized)
+    GST_INFO_OBJECT (dec, "resolution changed from %dx%d to %dx%d",
+        dec->ppconfig.ppInImg.width, dec->ppconfig.ppInImg.height,
+        width, height);
+  g_mutex_unlock (&dec->pp_lock);
+
+  /* The first size is followed the same way as the later ones, always
+     from the streaming thread */
+  if (dec->worker && g_thread_self () == dec->worker) {
+    gst_g1_base_dec_async_resize (dec, resized, width, height);
+  } else {
+    if (resized)
+      gst_g1_base_dec_resize_drain (dec);
+    gst_g1_base_dec_resize_output (dec, resized, width, height);
+  }
+
+  g_mutex_lock (&dec->pp_lock);
+
+  if (resized)
+    dec->pp_dirty |= PP_DIRTY_OUTPUT;
+
+  dec->ppconfig.ppInImg.pixFormat = gst_format_g1_to_pp (fmt);
   dec->ppconfig.ppInImg.width = width;
   dec->ppconfig.ppInImg.height = height;
+  dec->pp_dirty |= PP_DIRTY_INPUT;
+
+  /* Deinterlacing depends on input format */
+  gst_g1_base_dec_config_deinterlace (dec);
 
   /* Cropping depends on input format */
   gst_g1_base_dec_config_crop (dec, dec->crop_x, dec->crop_y,
       dec->crop_width, dec->crop_height);
+
+  g_mutex_unlock (&dec->pp_lock);
+}
+
+void
+gst_g1_base_dec_config_buffers (GstG1BaseDec * dec, guint dpb_size,
+    guint multibuff_size)
+{
+  if (dpb_size == dec->dpb_size && multibuff_size == dec->multibuff_size)
+    return;
+
+  GST_INFO_OBJECT (dec, "decoder holds %d pictures, %d post processor "
+      "buffers", dpb_size, multibuff_size);
+
+  dec->dpb_size = dpb_size;
+  dec->multibuff_size = multibuff_size;
+
+  /* The output pool was sized before the headers were parsed */
+  gst_pad_mark_reconfigure (GST_VIDEO_DECODER_SRC_PAD (dec));
+}
+
+void
+gst_g1_base_dec_config_interlaced (GstG1BaseDec * dec, gboolean interlaced)
+{
+  g_return_if_fail (dec);
+
+  g_mutex_lock (&dec->pp_lock);
+  if (interlaced != dec->interlaced) {
+    GST_INFO_OBJECT (dec, "%s stream", interlaced ? "interlaced" :
+        "progressive");
+    dec->interlaced = interlaced;
+    gst_g1_base_dec_config_deinterlace (dec);
+  }
+  g_mutex_unlock (&dec->pp_lock);
+}
+
+/* Caps tell downstream whether fields are left to it. Sets the interlace
+   mode of the output from the streaming thread, which owns the output
+   state, right before a picture post processed that way is pushed */
+static void
+gst_g1_base_dec_output_interlace (GstG1BaseDec * dec, gboolean interlaced)
+{
+  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
+  GstVideoCodecState *state;
+  GstVideoCodecState *newstate;
+
+  state = gst_video_decoder_get_output_state (bdec);
+  if (!state)
+    return;
+
+  if (interlaced == GST_VIDEO_INFO_IS_INTERLACED (&state->info))
+    goto exit;
+
+  newstate = gst_video_decoder_set_output_state (bdec,
+      GST_VIDEO_INFO_FORMAT (&state->info),
+      GST_VIDEO_INFO_WIDTH (&state->info),
+      GST_VIDEO_INFO_HEIGHT (&state->info), state);
+  GST_VIDEO_INFO_INTERLACE_MODE (&newstate->info) = interlaced ?
+      GST_VIDEO_INTERLACE_MODE_INTERLEAVED :
+      GST_VIDEO_INTERLACE_MODE_PROGRESSIVE;
+  gst_video_codec_state_unref (newstate);
+
+  if (!gst_video_decoder_negotiate (bdec)) {
+    GST_WARNING_OBJECT (dec, "unable to negotiate %s output",
+        interlaced ? "interlaced" : "progressive");
+    gst_pad_mark_reconfigure (GST_VIDEO_DECODER_SRC_PAD (dec));
+  }
+
+exit:
+  {
+    gst_video_codec_state_unref (state);
+  }
+}
+
+/* Returns whether the post processor deinterlaces. Must be called with
+   the pp lock held */
+static gboolean
+gst_g1_base_dec_config_deinterlace (GstG1BaseDec * g1dec)
+{
+  PPConfig *config = &g1dec->ppconfig;
+  gboolean enable;
+
+  enable = GST_G1_DEINTERLACE_ON == g1dec->deinterlace ||
+      (GST_G1_DEINTERLACE_AUTO == g1dec->deinterlace && g1dec->interlaced);
+
+  /* Only frames holding both fields of a 4:2:0 semiplanar picture */
+  if (enable && config->ppInImg.pixFormat &&
+      config->ppInImg.pixFormat != PP_PIX_FMT_YCBCR_4_2_0_SEMIPLANAR) {
+    GST_WARNING_OBJECT (g1dec, "unable to deinterlace this input format");
+    enable = FALSE;
+  }
+
+  if (enable == (config->ppOutDeinterlace.enable != 0))
+    return enable;
+
+  GST_INFO_OBJECT (g1dec, "deinterlacing %s", enable ? "enabled" :
+      "disabled");
+
+  config->ppOutDeinterlace.enable = enable;
+  config->ppInImg.picStruct = enable ? PP_PIC_TOP_AND_BOT_FIELD_FRAME :
+      PP_PIC_FRAME_OR_TOP_FIELD;
+  g1dec->pp_dirty |= PP_DIRTY_DEINTERLACE;
+
+  return enable;
 }
 
 static void
@@ -995,6 +4625,7 @@ gst_g1_base_dec_config_rotation (GstG1BaseDec * g1dec, gint rotation)
    * checks here */
   g1dec->rotation = rotation;
   g1dec->ppconfig.ppInRotation.rotation = g1dec->rotation;
+  g1dec->pp_dirty |= PP_DIRTY_ROTATION;
 }
 
 static void
@@ -1002,6 +4633,7 @@ gst_g1_base_dec_config_brightness (GstG1BaseDec * g1dec, gint brightness)
 {
   g1dec->brightness = brightness;
   g1dec->ppconfig.ppOutRgb.brightness = g1dec->brightness;
+  g1dec->pp_dirty |= PP_DIRTY_COLOR;
 }
 
 static void
@@ -1009,6 +4641,7 @@ gst_g1_base_dec_config_contrast (GstG1BaseDec * g1dec, gint contrast)
 {
   g1dec->contrast = contrast;
   g1dec->ppconfig.ppOutRgb.contrast = g1dec->contrast;
+  g1dec->pp_dirty |= PP_DIRTY_COLOR;
 }
 
 static void
@@ -1016,29 +4649,27 @@ gst_g1_base_dec_config_saturation (GstG1BaseDec * g1dec, gint saturation)
 {
   g1dec->saturation = saturation;
   g1dec->ppconfig.ppOutRgb.saturation = g1dec->saturation;
+  g1dec->pp_dirty |= PP_DIRTY_COLOR;
 }
 
-static void
+/* Returns whether the mask file has to be loaded again, which is left
+   to gst_g1_base_dec_load_mask1 () once the pp lock is released. Must
+   be called with the pp lock held */
+static gboolean
 gst_g1_base_dec_config_mask1 (GstG1BaseDec * g1dec,
     const gchar * location, gint x, gint y, gint width, gint height)
 {
-  FILE *rgbfile = NULL;
-  gsize rgbsize;
-  gchar *tmplocation;
-
-  if (location != NULL) {
-    tmplocation = g1dec->mask1_location;
+  gboolean reload = FALSE;
 
-    if (location) {
-      g1dec->mask1_location = g_strdup (location);
-    } else {
-      g1dec->mask1_location = NULL;
-    }
-    if (tmplocation) {
-      g_free (tmplocation);
-    }
+  if (location != (gpointer) - 1 &&
+      g_strcmp0 (location, g1dec->mask1_location)) {
+    g_free (g1dec->mask1_location);
+    g1dec->mask1_location = g_strdup (location);
+    reload = TRUE;
   }
 
+  g1dec->pp_dirty |= PP_DIRTY_MASK1;
+
   if (x != -1) {
     g1dec->mask1_x = x;
     g1dec->ppconfig.ppOutMask1.originX = g1dec->mask1_x;
@@ -1052,41 +4683,26 @@ gst_g1_base_dec_config_mask1 (GstG1BaseDec * g1dec,
   }
 
   if (width != -1) {
+    reload |= g1dec->mask1_width != width;
     g1dec->mask1_width = width;
     g1dec->ppconfig.ppOutMask1.width = g1dec->mask1_width;
     g1dec->ppconfig.ppOutMask1.blendWidth = g1dec->mask1_width;
   }
 
   if (height != -1) {
+    reload |= g1dec->mask1_height != height;
     g1dec->mask1_height = height;
     g1dec->ppconfig.ppOutMask1.height = g1dec->mask1_height;
     g1dec->ppconfig.ppOutMask1.blendHeight = g1dec->mask1_height;
   }
 
-  /* Check if we have enough info to configure ourselves */
-  if (g1dec->mask1_location && g1dec->mask1_height && g1dec->mask1_width
-      && g1dec->allocator) {
-    if (g1dec->mask1_mem) {
-      gst_allocator_free (g1dec->allocator, g1dec->mask1_mem);
-      g1dec->mask1_mem = NULL;
-    }
-
-    rgbfile = fopen (g1dec->mask1_location, "r");
-    if (!rgbfile) {
-      GST_ERROR_OBJECT (g1dec, "unable to open mask1 %s: %s",
-          g1dec->mask1_location, strerror (errno));
-      goto exit;
-    }
-    rgbsize = g1dec->mask1_width * g1dec->mask1_height * 4;
-    g1dec->mask1_mem =
-        (GstG1Memory *) gst_allocator_alloc (g1dec->allocator, rgbsize, NULL);
-    if (rgbsize != fread (g1dec->mask1_mem->virtaddress, 1, rgbsize, rgbfile)) {
-      GST_ERROR_OBJECT (g1dec, "error reading mask1 %s", g1dec->mask1_location);
-      gst_allocator_free (g1dec->allocator, (GstMemory *) g1dec->mask1_mem);
-      g1dec->mask1_mem = NULL;
-      goto exit;
-    }
+  /* The pixels loaded don't match the mask anymore */
+  if (reload && g1dec->mask1_mem) {
+    gst_allocator_free (g1dec->allocator, (GstMemory *) g1dec->mask1_mem);
+    g1dec->mask1_mem = NULL;
+  }
 
+  if (g1dec->mask1_mem) {
     g1dec->ppconfig.ppOutMask1.enable = 1;
     g1dec->ppconfig.ppOutMask1.alphaBlendEna = 1;
     g1dec->ppconfig.ppOutMask1.blendComponentBase =
@@ -1097,10 +4713,71 @@ gst_g1_base_dec_config_mask1 (GstG1BaseDec * g1dec,
     g1dec->ppconfig.ppOutMask1.blendComponentBase = 0;
   }
 
+  return reload && g1dec->mask1_location && g1dec->mask1_width &&
+      g1dec->mask1_height;
+}
+
+/* Reads the mask file into memory the post processor blends from. The
+   file is read without the pp lock, the pixels are only taken if the
+   mask wasn't changed meanwhile */
+static void
+gst_g1_base_dec_load_mask1 (GstG1BaseDec * g1dec)
+{
+  GstAllocator *allocator;
+  GstG1Memory *mem = NULL;
+  FILE *rgbfile = NULL;
+  gchar *location;
+  gsize rgbsize;
+  guint width;
+  guint height;
+
+  g_mutex_lock (&g1dec->pp_lock);
+  location = g_strdup (g1dec->mask1_location);
+  width = g1dec->mask1_width;
+  height = g1dec->mask1_height;
+  allocator = g1dec->allocator ? gst_object_ref (g1dec->allocator) : NULL;
+  g_mutex_unlock (&g1dec->pp_lock);
+
+  /* Loaded once the decoder is opened */
+  if (!location || !width || !height || !allocator)
+    goto exit;
+
+  rgbfile = fopen (location, "r");
+  if (!rgbfile) {
+    GST_ERROR_OBJECT (g1dec, "unable to open mask1 %s: %s", location,
+        strerror (errno));
+    goto exit;
+  }
+  rgbsize = width * height * 4;
+  mem = (GstG1Memory *) gst_allocator_alloc (allocator, rgbsize, NULL);
+  if (!mem) {
+    GST_ERROR_OBJECT (g1dec, "unable to allocate mask1 memory");
+    goto exit;
+  }
+  if (rgbsize != fread (mem->virtaddress, 1, rgbsize, rgbfile)) {
+    GST_ERROR_OBJECT (g1dec, "error reading mask1 %s", location);
+    goto exit;
+  }
+
+  g_mutex_lock (&g1dec->pp_lock);
+  if (!g1dec->mask1_mem && !g_strcmp0 (location, g1dec->mask1_location) &&
+      width == g1dec->mask1_width && height == g1dec->mask1_height &&
+      allocator == g1dec->allocator) {
+    g1dec->mask1_mem = mem;
+    mem = NULL;
+    gst_g1_base_dec_config_mask1 (g1dec, (gpointer) - 1, -1, -1, -1, -1);
+  }
+  g_mutex_unlock (&g1dec->pp_lock);
+
 exit:
   {
     if (rgbfile)
       fclose (rgbfile);
+    if (mem)
+      gst_allocator_free (allocator, (GstMemory *) mem);
+    if (allocator)
+      gst_object_unref (allocator);
+    g_free (location);
   }
 }
 
@@ -1108,18 +4785,14 @@ static void
 gst_g1_base_dec_config_crop (GstG1BaseDec * g1dec,
     gint x, gint y, gint width, gint height)
 {
-  GstVideoCodecState *state;
-  GstVideoInfo *vinfo;
   gint tmp;
   gint tmpres;
   gint ppinres;
   gboolean configured;
 
-  state = gst_video_decoder_get_output_state (GST_VIDEO_DECODER (g1dec));
-  vinfo = &state->info;
   ppinres = g1dec->ppconfig.ppInImg.width;
 
-  if (!ppinres || !state)
+  if (!ppinres || !g1dec->out_width || !g1dec->out_height)
     configured = FALSE;
   else
     configured = TRUE;
@@ -1158,23 +4831,21 @@ gst_g1_base_dec_config_crop (GstG1BaseDec * g1dec,
     height = tmp;
   }
 
-  if (state && width && width != -1) {
-    if (GST_VIDEO_INFO_WIDTH (vinfo)
-        && ((3 * width) < GST_VIDEO_INFO_WIDTH (vinfo))) {
+  if (width && width != -1) {
+    if (g1dec->out_width && ((3 * width) < g1dec->out_width)) {
       GST_ERROR_OBJECT (g1dec,
           "crop width (%d) must be at least 1/3 of the output width (%d)",
-          width, GST_VIDEO_INFO_WIDTH (vinfo));
-      goto exit;
+          width, g1dec->out_width);
+      return;
     }
   }
 
-  if (state && height && height != -1) {
-    if (GST_VIDEO_INFO_HEIGHT (vinfo)
-        && ((3 * height - 2) < GST_VIDEO_INFO_HEIGHT (vinfo))) {
+  if (height && height != -1) {
+    if (g1dec->out_height && ((3 * height - 2) < g1dec->out_height)) {
       GST_ERROR_OBJECT (g1dec,
           "crop height (%d) must be at least 1/3 of the output height (%d)",
-          height, GST_VIDEO_INFO_HEIGHT (vinfo));
-      goto exit;
+          height, g1dec->out_height);
+      return;
     }
   }
 
@@ -1185,7 +4856,7 @@ gst_g1_base_dec_config_crop (GstG1BaseDec * g1dec,
     if (ppinres && (tmp + tmpres) > ppinres) {
       GST_ERROR_OBJECT (g1dec, "{(X+Width) = (%d+%d)} > {InWidth = %d}",
           tmp, tmpres, ppinres);
-      goto exit;
+      return;
     }
   }
 
@@ -1197,7 +4868,7 @@ gst_g1_base_dec_config_crop (GstG1BaseDec * g1dec,
     if (ppinres && (tmp + tmpres) > ppinres) {
       GST_ERROR_OBJECT (g1dec, "{(Y+Height) = (%d+%d)} > {InHeight = %d}",
           tmp, tmpres, ppinres);
-      goto exit;
+      return;
     }
   }
 
@@ -1223,11 +4894,7 @@ gst_g1_base_dec_config_crop (GstG1BaseDec * g1dec,
     g1dec->ppconfig.ppInCrop.enable = 1;
   }
 
-exit:
-  {
-    if (state)
-      gst_video_codec_state_unref (state);
-  }
+  g1dec->pp_dirty |= PP_DIRTY_CROP;
 }
 
 static gboolean
@@ -1247,6 +4914,7 @@ gst_g1_base_dec_setup_pp (GstG1BaseDec * g1dec)
   g1dec->ppconfig.ppInImg.pixFormat = 0;
 
   gst_g1_base_dec_config_rotation (g1dec, g1dec->rotation);
+  gst_g1_base_dec_config_deinterlace (g1dec);
   gst_g1_base_dec_config_brightness (g1dec, g1dec->brightness);
   gst_g1_base_dec_config_contrast (g1dec, g1dec->contrast);
   gst_g1_base_dec_config_saturation (g1dec, g1dec->saturation);
@@ -1255,6 +4923,8 @@ gst_g1_base_dec_setup_pp (GstG1BaseDec * g1dec)
   gst_g1_base_dec_config_mask1 (g1dec, g1dec->mask1_location, g1dec->mask1_x,
       g1dec->mask1_y, g1dec->mask1_width, g1dec->mask1_height);
 
+  g1dec->pp_dirty = PP_DIRTY_ALL;
+
   ret = TRUE;
 
 exit:
@@ -1280,6 +4950,10 @@ gst_g1_base_dec_sink_query (GstVideoDecoder * decoder, GstQuery * query)
       if (g1dec->dectype == PP_PIPELINED_DEC_TYPE_H264) {
         caps = gst_caps_new_simple ("video/x-h264",
             "stream-format", G_TYPE_STRING, "byte-stream", NULL);
+        /* Converted to byte-stream while copied to contiguous memory */
+        gst_caps_append (caps, gst_caps_new_simple ("video/x-h264",
+                "stream-format", G_TYPE_STRING, "avc",
+                "alignment", G_TYPE_STRING, "au", NULL));
         gst_query_set_caps_result (query, caps);
         gst_caps_unref (caps);
         ret = TRUE;
@@ -1298,8 +4972,18 @@ gst_g1_base_dec_sink_query (GstVideoDecoder * decoder, GstQuery * query)
         gst_caps_unref (caps);
         ret = TRUE;
       } else if (g1dec->dectype == PP_PIPELINED_DEC_TYPE_JPEG) {
-        caps = gst_caps_new_simple ("image/jpeg",
-            "parsed", G_TYPE_BOOLEAN, TRUE, NULL);
+        GstCaps *filter;
+
+        /* Parsed images as well as Motion JPEG */
+        gst_query_parse_caps (query, &filter);
+        caps = gst_pad_get_pad_template_caps (pad);
+        if (filter) {
+          GstCaps *tmp = caps;
+
+          caps = gst_caps_intersect_full (filter, tmp,
+              GST_CAPS_INTERSECT_FIRST);
+          gst_caps_unref (tmp);
+        }
         gst_query_set_caps_result (query, caps);
         gst_caps_unref (caps);
         ret = TRUE;
@@ -22,7 +22,10 @@
 
 #include <gst/gst.h>
 #include <gst/video/gstvideodecoder.h>
+#include <gst/video/video-overlay-composition.h>
 #include "gstdwlallocator.h"
+#include "gstg1scheduler.h"
+#include "gstg1enum.h"
 
 #include <g1decoder/ppapi.h>
 
@@ -37,6 +40,36 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_G1_BASE_DEC))
 #define GST_IS_G1_BASE_DEC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_G1_BASE_DEC))
+/* Formats the post processor writes */
+#define GST_G1_BASE_DEC_SRC_CAPS GST_VIDEO_CAPS_MAKE \
+    ("{ GRAY8, YUY2, YVYU, UYVY, NV16, I420, NV12, RGB15, RGB16, BGR15, BGR16, RGBx, BGRx }")
+/* Stages of a frame timed for the stats */
+typedef enum
+{
+  GST_G1_BASE_DEC_STAGE_COPY,
+  GST_G1_BASE_DEC_STAGE_DECODE,
+  GST_G1_BASE_DEC_STAGE_PP,
+  GST_G1_BASE_DEC_STAGE_PUSH,
+  GST_G1_BASE_DEC_N_STAGES
+} GstG1BaseDecStage;
+
+/* Events counted in the stats */
+typedef enum
+{
+  GST_G1_BASE_DEC_CONCEALED_MBS,
+  GST_G1_BASE_DEC_SKIPPED_PICTURES,
+  GST_G1_BASE_DEC_BYTES_COPIED,
+  GST_G1_BASE_DEC_N_COUNTERS
+} GstG1BaseDecCounter;
+
+#define GST_G1_BASE_DEC_STATS_BUCKETS 8
+
+/* Post processor masks overlay rectangles are blended with */
+#define GST_G1_BASE_DEC_OVERLAY_MASKS 2
+
+/* More pictures than any codec holds, draining stops after as many */
+#define GST_G1_BASE_DEC_MAX_PICTURES 32
+
 typedef struct _GstG1BaseDec GstG1BaseDec;
 typedef struct _GstG1BaseDecClass GstG1BaseDecClass;
 
@@ -47,10 +80,21 @@ struct _GstG1BaseDec
   gpointer codec;
   guint32 dectype;
   PPInst pp;
+
+  /* Shadow copy of the post processor configuration, the sections that
+     changed since it was last programmed, and the lock protecting both
+     (and the settings they are built from) from property changes */
   PPConfig ppconfig;
+  guint pp_dirty;
+  GMutex pp_lock;
 
   gint rotation;
 
+  /* Deinterlacing mode, and whether the stream headers say the
+     pictures hold two fields */
+  GstG1Deinterlace deinterlace;
+  gboolean interlaced;
+
   gint brightness;
   gint contrast;
   gint saturation;
@@ -60,6 +104,26 @@ struct _GstG1BaseDec
   guint crop_width;
   guint crop_height;
 
+  /* Size of the negotiated output, the crop is checked against */
+  gint out_width;
+  gint out_height;
+
+  /* Crop following the region of interest of each frame, taken from its
+     meta when roi_crop is set or from the last g1-crop event, and whether
+     it replaces the crop above at the moment */
+  gboolean roi_crop;
+  gchar *roi_type;
+  guint roi_x;
+  guint roi_y;
+  guint roi_width;
+  guint roi_height;
+  gboolean roi_active;
+
+  /* Frame number of the picture the post processor is set up for, and
+     whether it leaves the fields of that picture to downstream */
+  guint32 pp_picture;
+  gboolean pp_interlaced;
+
   guint x;
   guint y;
   guint w;
@@ -70,10 +134,140 @@ struct _GstG1BaseDec
   guint mask1_width;
   guint mask1_height;
   gchar *mask1_location;
+  /* Pixels of the mask file, loaded outside of the pp lock */
   GstG1Memory *mask1_mem;
 
+  /* Overlay composition of the last g1-overlay event, for the frames
+     without a composition meta */
+  GstVideoOverlayComposition *overlay;
+
+  /* Overlay rectangles uploaded for each mask, which rectangle they
+     hold, and the masks the overlays currently take */
+  GstG1Memory *overlay_mem[GST_G1_BASE_DEC_OVERLAY_MASKS];
+  guint overlay_seqnum[GST_G1_BASE_DEC_OVERLAY_MASKS];
+  guint overlay_masks;
+
   /* TODO: move to a private */
   GstAllocator *allocator;
+
+  /* Size of the input buffers proposed upstream, and the largest
+     access unit received so far */
+  guint input_size;
+  guint max_input_size;
+
+  /* Whether access units are rewritten by fill_input, and so copied
+     even if they are in G1 memory already */
+  gboolean convert_input;
+
+  /* Optional contiguous ring holding the compressed input, and the
+     write position of the next access unit. The ring stays mapped
+     for as long as it is allocated. */
+  guint input_ring_size;
+  GstMemory *input_ring;
+  GstMapInfo input_ring_map;
+  gsize input_ring_offset;
+
+  /* Asynchronous decoding: a worker thread owns the hardware, frames to
+     decode and decoded pictures travel through bounded queues */
+  gboolean async_decode;
+  GThread *worker;
+  GMutex async_lock;
+  GCond async_cond;
+  GQueue input_queue;
+  GQueue output_queue;
+  GstVideoCodecFrame *worker_frame;
+  gboolean worker_stop;
+  gboolean flushing;
+  GstFlowReturn async_ret;
+
+  /* A new stream size the worker waits for the streaming thread to
+     switch the output to, whether it differs from the previous one and
+     whether the pictures of the previous one were drained already */
+  gboolean resize_pending;
+  gboolean resize_changed;
+  gboolean resize_drained;
+  gint32 resize_width;
+  gint32 resize_height;
+
+  /* Buffer the post processor writes the next picture into, and the
+     frames whose picture hasn't been output yet, by picture id */
+  GstBuffer *output_buffer;
+  GHashTable *pictures;
+
+  /* Pictures the decoder holds on to, as reported by the stream
+     headers, and size of the post processor multibuffer ring */
+  guint dpb_size;
+  guint multibuff_size;
+
+  /* Post processor multibuffer mode: the ring of output buffers the
+     hardware cycles through, registered once per pool configuration,
+     the pool they come from, and the ring buffers downstream holds,
+     guarded by the native lock */
+  gboolean pp_multibuffer;
+  GPtrArray *multibuff;
+  PPOutputBuffers multibuff_config;
+  GstBufferPool *multibuff_pool;
+  guint multibuff_next;
+  gpointer multibuff_held[PP_MAX_MULTIBUFFER];
+
+  /* Whether the post processor is left out of the chain so the codec
+     pictures are output directly */
+  gboolean pp_bypass;
+
+  /* Output pictures the codec leaves untouched, which downstream may
+     hold on to without a copy. The native lock guards the pictures
+     downstream holds, mapped to their position among the pictures
+     output, and the native cond signals each one returned. */
+  guint native_max;
+  guint native_outputs;
+  GHashTable *native_pictures;
+  gboolean native_flushing;
+  GMutex native_lock;
+  GCond native_cond;
+
+  /* Whether late frames skip work, and whether the post processor was
+     left out for the frame being decoded because it is late */
+  gboolean qos;
+  gboolean pp_skipped;
+
+  /* Whether the current segment is a trick mode one */
+  gboolean trick_mode;
+
+  /* Stage timing histograms and counters behind the stats property,
+     protected by the object lock, and when they were last posted. The
+     hardware time of the frame being decoded is summed up apart. */
+  guint64 stats_histogram[GST_G1_BASE_DEC_N_STAGES]
+      [GST_G1_BASE_DEC_STATS_BUCKETS];
+  GstClockTime stats_time[GST_G1_BASE_DEC_N_STAGES];
+  guint64 stats_counters[GST_G1_BASE_DEC_N_COUNTERS];
+  guint64 stats_frames;
+  guint stats_interval;
+  GstClockTime stats_posted;
+  GstClockTime frame_decode_time;
+  GstClockTime hw_start;
+
+  /* Optional second output written by a standalone post processor pass
+     over the pictures of the first one: its request pad, the post
+     processor instance, and the format and pool negotiated for it. The
+     pad, format and pool are protected by the object lock */
+  GstPad *analytics_pad;
+  PPInst analytics_pp;
+  GstVideoInfo analytics_info;
+  GstBufferPool *analytics_pool;
+
+  /* Registration with the scheduler arbitrating the G1 core between
+     instances, and how this one is scheduled */
+  GstG1SchedulerClient *scheduler;
+  gint priority;
+  GstG1SchedulerPolicy scheduling;
+
+  /* Whether the output size follows the stream, because downstream
+     left it open, the largest resolution output buffers are allocated
+     for, and the G1 pool holding them */
+  gboolean follow_input;
+  guint max_width;
+  guint max_height;
+  GstBufferPool *output_pool;
 };
 
 struct _GstG1BaseDecClass
@@ -85,16 +279,44 @@ struct _GstG1BaseDecClass
     GstFlowReturn (*decode) (GstG1BaseDec * dec, GstVideoCodecFrame * frame);
     GstFlowReturn (*decode_header) (GstG1BaseDec * dec,
       GstBuffer * streamheader);
+    GstFlowReturn (*drain) (GstG1BaseDec * dec);
+
+  /* Writes an access unit to contiguous memory the way the hardware
+     expects it, and returns the size written, or 0 if it is malformed.
+     With a NULL dest only the size is returned. Defaults to a copy. */
+    gsize (*fill_input) (GstG1BaseDec * dec, guint8 * dest,
+      const guint8 * data, gsize size);
 };
 
 GType gst_g1_base_dec_get_type (void);
 
-void gst_g1_base_dec_config_format (GstG1BaseDec * dec,
-    GstVideoFormatInfo * fmt, gint32 width, gint32 height);
+void gst_g1_base_dec_config_format (GstG1BaseDec * dec, guint32 fmt,
+    gint32 width, gint32 height);
+void gst_g1_base_dec_config_buffers (GstG1BaseDec * dec, guint dpb_size,
+    guint multibuff_size);
+void gst_g1_base_dec_config_interlaced (GstG1BaseDec * dec,
+    gboolean interlaced);
 GstFlowReturn gst_g1_base_dec_allocate_output (GstG1BaseDec * dec,
     GstVideoCodecFrame * frame);
 GstFlowReturn gst_g1_base_dec_push_data (GstG1BaseDec * dec,
     GstVideoCodecFrame * frame);
+void gst_g1_base_dec_queue_picture (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame);
+GstFlowReturn gst_g1_base_dec_push_picture (GstG1BaseDec * dec,
+    guint32 picid);
+void gst_g1_base_dec_native_picture (GstG1BaseDec * dec,
+    gpointer virtaddress, guint32 physaddress);
+void gst_g1_base_dec_discard_picture (GstG1BaseDec * dec);
+gboolean gst_g1_base_dec_skip_pictures (GstG1BaseDec * dec, gboolean skip);
+gboolean gst_g1_base_dec_late (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame);
+gboolean gst_g1_base_dec_skip_non_reference (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame);
+void gst_g1_base_dec_hw_acquire (GstG1BaseDec * dec,
+    GstVideoCodecFrame * frame);
+void gst_g1_base_dec_hw_release (GstG1BaseDec * dec);
+void gst_g1_base_dec_count (GstG1BaseDec * dec, GstG1BaseDecCounter counter,
+    guint64 value);
 
 G_END_DECLS
 #endif /*__GST_G1_BASE_DEC_H__*/
@@ -39,26 +39,31 @@
 #include <g1decoder/h264decapi.h>
 #include <g1decoder/dwl.h>
 
+#include <string.h>
+
 enum
 {
   PROP_0,
   PROP_SKIP_NON_REFERENCE,
   PROP_DISABLE_OUTPUT_REORDERING,
   PROP_INTRA_FREEZE_CONCEALMENT,
-  PROP_USE_DISPLAY_SMOOTHING
+  PROP_USE_DISPLAY_SMOOTHING,
+  PROP_TILED_REFERENCE
 };
 
 #define PROP_DEFAULT_SKIP_NON_REFERENCE FALSE
 #define PROP_DEFAULT_DISABLE_OUTPUT_REORDERING FALSE
 #define PROP_DEFAULT_INTRA_FREEZE_CONCEALMENT FALSE
 #define PROP_DEFAULT_USE_DISPLAY_SMOOTHING FALSE
+#define PROP_DEFAULT_TILED_REFERENCE FALSE
 
 static GstStaticPadTemplate gst_g1_h264_dec_sink_pad_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("video/x-h264, "
-        "stream-format=byte-stream, " "alignment={au,nal}")
+        "stream-format=byte-stream, " "alignment={au,nal}; "
+        "video/x-h264, " "stream-format=avc, " "alignment=au")
     );
 
 GST_DEBUG_CATEGORY_STATIC (g1_h264_dec_debug);
@@ -70,6 +75,9 @@ G_DEFINE_TYPE (GstG1H264Dec, gst_g1_h264_dec, GST_TYPE_G1_BASE_DEC);
 
 #define GST_G1_H264_FAILED(ret) (H264DEC_OK != (ret))
 
+/* Prefix of every NAL unit in a byte-stream */
+static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+
 static void gst_g1_h264_dec_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static void gst_g1_h264_dec_set_property (GObject * object, guint prop_id,
@@ -77,21 +85,31 @@ static void gst_g1_h264_dec_set_property (GObject * object, guint prop_id,
 
 static gboolean gst_g1_h264_dec_open (GstG1BaseDec * dec);
 static gboolean gst_g1_h264_dec_close (GstG1BaseDec * dec);
+static GstFlowReturn gst_g1_h264_dec_drain (GstG1BaseDec * dec);
 static GstFlowReturn gst_g1_h264_dec_decode (GstG1BaseDec * decoder,
     GstVideoCodecFrame * frame);
+static gsize gst_g1_h264_dec_fill_input (GstG1BaseDec * dec, guint8 * dest,
+    const guint8 * data, gsize size);
+static gboolean gst_g1_h264_dec_set_format (GstVideoDecoder * decoder,
+    GstVideoCodecState * state);
+static gboolean gst_g1_h264_dec_parse_avcc (GstG1H264Dec * dec,
+    GstBuffer * codec_data);
 
 static void gst_g1_h264_dec_dwl_to_h264 (GstG1H264Dec * dec,
-    DWLLinearMem_t * linearmem, H264DecInput * input, gsize size);
+    DWLLinearMem_t * linearmem, H264DecInput * input, gsize size,
+    guint32 picid);
 
 static void
 gst_g1_h264_dec_class_init (GstG1H264DecClass * klass)
 {
   GObjectClass *gobject_class;
   GstElementClass *element_class;
+  GstVideoDecoderClass *video_decoder_class;
   GstG1BaseDecClass *g1dec_class;
 
   gobject_class = (GObjectClass *) klass;
   element_class = (GstElementClass *) klass;
+  video_decoder_class = (GstVideoDecoderClass *) klass;
   g1dec_class = (GstG1BaseDecClass *) klass;
 
   parent_class = g_type_class_peek_parent (klass);
@@ -131,9 +149,23 @@ gst_g1_h264_dec_class_init (GstG1H264DecClass * klass)
           PROP_DEFAULT_USE_DISPLAY_SMOOTHING,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_TILED_REFERENCE,
+      g_param_spec_boolean ("tiled-reference", "Tiled Reference",
+          "Store reference pictures in the tiled layout, which takes less "
+          "memory bandwidth. The post processor converts them to the output "
+          "format. "
+          "This property will take effect until the next time the codec "
+          "is opened.", PROP_DEFAULT_TILED_REFERENCE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   g1dec_class->open = GST_DEBUG_FUNCPTR (gst_g1_h264_dec_open);
   g1dec_class->close = GST_DEBUG_FUNCPTR (gst_g1_h264_dec_close);
   g1dec_class->decode = GST_DEBUG_FUNCPTR (gst_g1_h264_dec_decode);
+  g1dec_class->drain = GST_DEBUG_FUNCPTR (gst_g1_h264_dec_drain);
+  g1dec_class->fill_input = GST_DEBUG_FUNCPTR (gst_g1_h264_dec_fill_input);
+
+  video_decoder_class->set_format =
+      GST_DEBUG_FUNCPTR (gst_g1_h264_dec_set_format);
 
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&gst_g1_h264_dec_sink_pad_template));
@@ -157,6 +189,11 @@ gst_g1_h264_dec_init (GstG1H264Dec * dec)
   dec->disable_output_reordering = PROP_DEFAULT_DISABLE_OUTPUT_REORDERING;
   dec->intra_freeze_concealment = PROP_DEFAULT_INTRA_FREEZE_CONCEALMENT;
   dec->use_display_smoothing = PROP_DEFAULT_USE_DISPLAY_SMOOTHING;
+  dec->tiled_reference = PROP_DEFAULT_TILED_REFERENCE;
+
+  dec->nal_length_size = 0;
+  dec->codec_header = NULL;
+  dec->send_header = FALSE;
 }
 
 static gboolean
@@ -171,6 +208,11 @@ gst_g1_h264_dec_open (GstG1BaseDec * g1dec)
 
   /* TODO: do we want this configurable? */
   flags = DEC_DPB_ALLOW_FIELD_ORDERING;
+  if (dec->tiled_reference)
+    flags |= DEC_REF_FRM_TILED_DEFAULT;
+
+  /* The extra buffers keep the last output picture intact */
+  g1dec->native_max = dec->use_display_smoothing ? 1 : 0;
 
   decret =
       H264DecInit ((H264DecInst *) & g1dec->codec,
@@ -210,6 +252,9 @@ gst_g1_h264_dec_set_property (GObject * object, guint prop_id,
     case PROP_USE_DISPLAY_SMOOTHING:
       dec->use_display_smoothing = g_value_get_boolean (value);
       break;
+    case PROP_TILED_REFERENCE:
+      dec->tiled_reference = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -235,6 +280,9 @@ gst_g1_h264_dec_get_property (GObject * object, guint prop_id,
     case PROP_USE_DISPLAY_SMOOTHING:
       g_value_set_boolean (value, dec->use_display_smoothing);
       break;
+    case PROP_TILED_REFERENCE:
+      g_value_set_boolean (value, dec->tiled_reference);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -247,7 +295,6 @@ gst_g1_h264_dec_parse_header (GstG1H264Dec * dec)
   GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
   GstG1BaseDec *g1dec = GST_G1_BASE_DEC (dec);
   GstFlowReturn ret;
-  GstVideoFormatInfo finfoi;
   GstVideoCodecState *state;
   H264DecInfo header;
   H264DecRet decret;
@@ -289,19 +336,12 @@ gst_g1_h264_dec_parse_header (GstG1H264Dec * dec)
   if (state) {
     state->info.par_n = header.sarWidth;
     state->info.par_d = header.sarHeight;
-
-    /* A 1 on either field means that it was a range at the time of
-       fixating caps. Likely the user didn't specify them. Use input
-       size */
-    if (1 == state->info.width || 1 == state->info.height) {
-      state->info.width = header.picWidth;
-      state->info.height = header.picHeight;
-    }
-
   }
-  finfoi = gst_format_g1_to_gst (header.outputFormat);
-  gst_g1_base_dec_config_format (g1dec, &finfoi,
+  gst_g1_base_dec_config_interlaced (g1dec, header.interlacedSequence);
+  gst_g1_base_dec_config_format (g1dec, header.outputFormat,
       header.picWidth, header.picHeight);
+  gst_g1_base_dec_config_buffers (g1dec, header.picBuffSize,
+      header.multiBuffPpSize);
 
   ret = GST_FLOW_OK;
 
@@ -312,16 +352,27 @@ exit:
 }
 
 static GstFlowReturn
-gst_g1_h264_dec_pop_picture (GstG1H264Dec * dec, GstVideoCodecFrame * frame)
+gst_g1_h264_dec_pop_picture (GstG1H264Dec * dec, gboolean eos)
 {
   GstG1BaseDec *bdec;
   H264DecPicture picture;
   H264DecRet decret;
+  GstFlowReturn ret;
+  guint n = 0;
 
   bdec = GST_G1_BASE_DEC (dec);
 
+  ret = GST_FLOW_OK;
   do {
-    decret = H264DecNextPicture (bdec->codec, &picture, FALSE);
+    /* Every picture gets post processed into its own buffer, unless
+       it is late and dropped */
+    if (!bdec->output_buffer && !bdec->pp_skipped) {
+      ret = gst_g1_base_dec_allocate_output (bdec, NULL);
+      if (GST_FLOW_OK != ret || !bdec->output_buffer)
+        break;
+    }
+
+    decret = H264DecNextPicture (bdec->codec, &picture, eos);
     GST_LOG_OBJECT (dec, "%s (%d) (%p|0x%08x)", gst_g1_result_h264 (decret),
         decret, picture.pOutputPicture, picture.outputPictureBusAddress);
 
@@ -330,22 +381,32 @@ gst_g1_h264_dec_pop_picture (GstG1H264Dec * dec, GstVideoCodecFrame * frame)
     }
     /* TODO: do some error checking here */
 
-    if (picture.nbrOfErrMBs)
+    if (picture.nbrOfErrMBs) {
       GST_WARNING_OBJECT (dec, "concealed %d macroblocks", picture.nbrOfErrMBs);
+      gst_g1_base_dec_count (bdec, GST_G1_BASE_DEC_CONCEALED_MBS,
+          picture.nbrOfErrMBs);
+    }
 
-    gst_g1_base_dec_push_data (bdec, frame);
+    /* Without the post processor the picture is output as decoded */
+    if (bdec->pp_bypass)
+      gst_g1_base_dec_native_picture (bdec,
+          (gpointer) picture.pOutputPicture, picture.outputPictureBusAddress);
 
-  } while (decret == H264DEC_PIC_RDY);
+    ret = gst_g1_base_dec_push_picture (bdec, picture.picId);
 
+  } while (decret == H264DEC_PIC_RDY && GST_FLOW_OK == ret &&
+      ++n < GST_G1_BASE_DEC_MAX_PICTURES);
 
+  if (n == GST_G1_BASE_DEC_MAX_PICTURES)
+    GST_WARNING_OBJECT (dec, "decoder keeps returning pictures, giving up");
 
   GST_LOG_OBJECT (dec, "No more pictures to pop");
-  return GST_FLOW_OK;
+  return ret;
 }
 
 static void
 gst_g1_h264_dec_dwl_to_h264 (GstG1H264Dec * dec, DWLLinearMem_t * linearmem,
-    H264DecInput * h264input, gsize size)
+    H264DecInput * h264input, gsize size, guint32 picid)
 {
   gboolean skip_non_reference;
 
@@ -361,7 +422,7 @@ gst_g1_h264_dec_dwl_to_h264 (GstG1H264Dec * dec, DWLLinearMem_t * linearmem,
   h264input->streamBusAddress = linearmem->busAddress;
   h264input->dataLen = size;
 
-  h264input->picId = 0;
+  h264input->picId = picid;
   h264input->skipNonReference = skip_non_reference;
   h264input->pUserData = NULL;
 }
@@ -386,13 +447,20 @@ gst_g1_h264_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
 
   error = FALSE;
 
-  gst_g1_h264_dec_dwl_to_h264 (dec, &linearmem, &h264input, minfo.size);
+  gst_g1_h264_dec_dwl_to_h264 (dec, &linearmem, &h264input, minfo.size,
+      frame->system_frame_number);
+
+  /* Catch up by not decoding what nothing else depends on */
+  if (gst_g1_base_dec_skip_non_reference (g1dec, frame))
+    h264input.skipNonReference = TRUE;
   do {
     ret = gst_g1_base_dec_allocate_output (g1dec, frame);
     if (GST_FLOW_OK != ret)
       break;
 
+    gst_g1_base_dec_hw_acquire (g1dec, frame);
     decret = H264DecDecode (g1dec->codec, &h264input, &h264output);
+    gst_g1_base_dec_hw_release (g1dec);
     GST_LOG_OBJECT (dec, "%s (%d), %d@(%p|0x%08x)", gst_g1_result_h264 (decret),
         decret, h264output.dataLeft, h264output.pStrmCurrPos,
         h264output.strmCurrBusAddress);
@@ -408,11 +476,17 @@ gst_g1_h264_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
         break;
 
       case H264DEC_PIC_DECODED:
-        ret = gst_g1_h264_dec_pop_picture (dec, frame);
+        /* Pictures are output in display order, possibly long after
+           being decoded */
+        gst_g1_base_dec_queue_picture (g1dec, frame);
+        ret = gst_g1_h264_dec_pop_picture (dec, FALSE);
         break;
 
-      case H264DEC_ADVANCED_TOOLS:
       case H264DEC_NONREF_PIC_SKIPPED:
+        gst_g1_base_dec_count (g1dec, GST_G1_BASE_DEC_SKIPPED_PICTURES, 1);
+        break;
+
+      case H264DEC_ADVANCED_TOOLS:
         /* NOP */
         break;
 
@@ -454,6 +528,15 @@ gst_g1_h264_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
   return ret;
 }
 
+static GstFlowReturn
+gst_g1_h264_dec_drain (GstG1BaseDec * g1dec)
+{
+  GstG1H264Dec *dec = GST_G1_H264_DEC (g1dec);
+
+  /* Flush the DPB, all the pictures left are output */
+  return gst_g1_h264_dec_pop_picture (dec, TRUE);
+}
+
 static gboolean
 gst_g1_h264_dec_close (GstG1BaseDec * g1dec)
 {
@@ -463,5 +546,160 @@ gst_g1_h264_dec_close (GstG1BaseDec * g1dec)
 
   H264DecRelease (g1dec->codec);
 
+  if (dec->codec_header) {
+    g_byte_array_unref (dec->codec_header);
+    dec->codec_header = NULL;
+  }
+
   return TRUE;
 }
+
+/* Keeps the SPS and PPS from the avcC codec data as byte-stream, to be
+   sent in front of the next access unit */
+static gboolean
+gst_g1_h264_dec_parse_avcc (GstG1H264Dec * dec, GstBuffer * codec_data)
+{
+  GByteArray *header;
+  GstMapInfo minfo;
+  const guint8 *data;
+  gsize offset;
+  guint nalsize;
+  guint count;
+  guint i, j;
+  gboolean ret;
+
+  if (!codec_data) {
+    GST_ERROR_OBJECT (dec, "avc stream without codec data");
+    return FALSE;
+  }
+
+  gst_buffer_map (codec_data, &minfo, GST_MAP_READ);
+  data = minfo.data;
+  header = g_byte_array_new ();
+  ret = FALSE;
+
+  if (minfo.size < 7 || 1 != data[0]) {
+    GST_ERROR_OBJECT (dec, "invalid avcC codec data");
+    goto exit;
+  }
+
+  dec->nal_length_size = (data[4] & 0x03) + 1;
+  offset = 5;
+
+  /* SPS come first, then PPS */
+  for (i = 0; i < 2; i++) {
+    if (offset >= minfo.size)
+      goto truncated;
+
+    count = i ? data[offset] : data[offset] & 0x1f;
+    offset++;
+
+    for (j = 0; j < count; j++) {
+      if (offset + 2 > minfo.size)
+        goto truncated;
+
+      nalsize = GST_READ_UINT16_BE (data + offset);
+      offset += 2;
+      if (offset + nalsize > minfo.size)
+        goto truncated;
+
+      g_byte_array_append (header, start_code, sizeof (start_code));
+      g_byte_array_append (header, data + offset, nalsize);
+      offset += nalsize;
+    }
+  }
+
+  GST_DEBUG_OBJECT (dec, "avc stream with %d byte NAL lengths, %d bytes "
+      "of parameter sets", dec->nal_length_size, header->len);
+
+  if (dec->codec_header)
+    g_byte_array_unref (dec->codec_header);
+  dec->codec_header = g_byte_array_ref (header);
+  dec->send_header = TRUE;
+
+  ret = TRUE;
+  goto exit;
+
+truncated:
+  {
+    GST_ERROR_OBJECT (dec, "truncated avcC codec data");
+  }
+exit:
+  {
+    g_byte_array_unref (header);
+    gst_buffer_unmap (codec_data, &minfo);
+    return ret;
+  }
+}
+
+static gboolean
+gst_g1_h264_dec_set_format (GstVideoDecoder * decoder,
+    GstVideoCodecState * state)
+{
+  GstG1H264Dec *dec = GST_G1_H264_DEC (decoder);
+  GstG1BaseDec *g1dec = GST_G1_BASE_DEC (decoder);
+  GstStructure *structure;
+  const gchar *format;
+
+  structure = gst_caps_get_structure (state->caps, 0);
+  format = gst_structure_get_string (structure, "stream-format");
+
+  /* Length prefixed NAL units are rewritten with start codes as they are
+     copied to contiguous memory */
+  g1dec->convert_input = !g_strcmp0 (format, "avc");
+  if (g1dec->convert_input
+      && !gst_g1_h264_dec_parse_avcc (dec, state->codec_data))
+    return FALSE;
+
+  return GST_VIDEO_DECODER_CLASS (parent_class)->set_format (decoder, state);
+}
+
+static gsize
+gst_g1_h264_dec_fill_input (GstG1BaseDec * g1dec, guint8 * dest,
+    const guint8 * data, gsize size)
+{
+  GstG1H264Dec *dec = GST_G1_H264_DEC (g1dec);
+  gsize written;
+  gsize offset;
+  gsize nalsize;
+  guint i;
+
+  written = 0;
+
+  if (dec->send_header && dec->codec_header) {
+    if (dest)
+      memcpy (dest, dec->codec_header->data, dec->codec_header->len);
+    written += dec->codec_header->len;
+  }
+
+  for (offset = 0; offset < size; offset += nalsize) {
+    if (offset + dec->nal_length_size > size)
+      goto truncated;
+
+    nalsize = 0;
+    for (i = 0; i < dec->nal_length_size; i++)
+      nalsize = (nalsize << 8) | data[offset++];
+
+    if (offset + nalsize > size)
+      goto truncated;
+
+    if (dest) {
+      memcpy (dest + written, start_code, sizeof (start_code));
+      memcpy (dest + written + sizeof (start_code), data + offset, nalsize);
+    }
+    written += sizeof (start_code) + nalsize;
+  }
+
+  /* The parameter sets only go out once */
+  if (dest)
+    dec->send_header = FALSE;
+
+  return written;
+
+truncated:
+  {
+    GST_WARNING_OBJECT (dec, "truncated NAL unit at offset %" G_GSIZE_FORMAT,
+        offset);
+    return 0;
+  }
+}
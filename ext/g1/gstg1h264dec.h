@@ -44,6 +44,14 @@ struct _GstG1H264Dec
   gboolean disable_output_reordering;
   gboolean intra_freeze_concealment;
   gboolean use_display_smoothing;
+  gboolean tiled_reference;
+
+  /* avc input: size of the NAL unit length prefix, the parameter sets
+     from the codec data as byte-stream, and whether they still have to
+     be sent to the decoder */
+  guint nal_length_size;
+  GByteArray *codec_header;
+  gboolean send_header;
 };
 
 struct _GstG1H264DecClass
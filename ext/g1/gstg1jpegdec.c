@@ -51,10 +51,19 @@ enum
   PROP_0,
   PROP_ERROR_CONCEALMENT,
   PROP_NUM_FRAMEBUFFER,
+  PROP_SLICE_ROWS,
+  PROP_DECODE_MODE,
 };
 
 #define PROP_DEFAULT_ERROR_CONCEALMENT      FALSE
 #define PROP_DEFAULT_NUM_FRAMEBUFFER        6
+#define PROP_DEFAULT_SLICE_ROWS             0
+#define PROP_DEFAULT_DECODE_MODE            GST_G1_JPEG_DEC_MODE_FULL
+
+/* Images larger than this are decoded in slices when the slice size is
+   left to the decoder, slices are then kept around this size */
+#define JPEG_SLICE_AUTO_PIXELS (8 * 1024 * 1024)
+#define JPEG_SLICE_PIXELS (1024 * 1024)
 
 static GstStaticPadTemplate gst_g1_jpeg_dec_sink_pad_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
@@ -63,7 +72,11 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_STATIC_CAPS ("image/jpeg,"
         "framerate = (fraction) [0/1, MAX],"
         "width = (int) [ 1, 8176 ],"
-        "height = (int) [ 1, 8176 ]," "parsed = true"));
+        "height = (int) [ 1, 8176 ]," "parsed = true; "
+        /* Motion JPEG sources push whole frames */
+        "image/jpeg,"
+        "framerate = (fraction) [1/MAX, MAX],"
+        "width = (int) [ 1, 8176 ]," "height = (int) [ 1, 8176 ]"));
 
 GST_DEBUG_CATEGORY_STATIC (g1_jpeg_dec_debug);
 
@@ -75,6 +88,28 @@ G_DEFINE_TYPE (GstG1JPEGDec, gst_g1_jpeg_dec, GST_TYPE_G1_BASE_DEC);
 
 #define GST_G1_JPEG_FAILED(ret) (JPEGDEC_OK != (ret))
 
+GType
+gst_g1_jpeg_dec_mode_get_type (void)
+{
+  static GType mode_type = 0;
+
+  static const GEnumValue mode_types[] = {
+    {GST_G1_JPEG_DEC_MODE_FULL, "Decode the full image", "full"},
+    {GST_G1_JPEG_DEC_MODE_THUMBNAIL_ONLY,
+        "Decode the embedded thumbnail, drop images without one",
+        "thumbnail-only"},
+    {GST_G1_JPEG_DEC_MODE_THUMBNAIL_IF_AVAILABLE,
+        "Decode the embedded thumbnail, or the full image without one",
+        "thumbnail-if-available"},
+    {0, NULL, NULL}
+  };
+
+  if (!mode_type) {
+    mode_type = g_enum_register_static ("GstG1JPEGDecMode", mode_types);
+  }
+  return mode_type;
+}
+
 static void gst_g1_jpeg_dec_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static void gst_g1_jpeg_dec_set_property (GObject * object, guint prop_id,
@@ -85,16 +120,23 @@ static GstFlowReturn gst_g1_jpeg_dec_decode (GstG1BaseDec * decoder,
     GstVideoCodecFrame * frame);
 static void gst_g1_jpeg_dec_dwl_to_jpeg (GstG1JPEGDec * dec,
     DWLLinearMem_t * linearmem, JpegDecInput * input, gsize size);
+static guint gst_g1_jpeg_dec_slice_rows (GstG1JPEGDec * dec,
+    JpegDecImageInfo * info);
+static void gst_g1_jpeg_dec_count_frame (GstG1JPEGDec * dec);
+static gboolean gst_g1_jpeg_dec_set_format (GstVideoDecoder * decoder,
+    GstVideoCodecState * state);
 
 static void
 gst_g1_jpeg_dec_class_init (GstG1JPEGDecClass * klass)
 {
   GObjectClass *gobject_class;
   GstElementClass *element_class;
+  GstVideoDecoderClass *video_decoder_class;
   GstG1BaseDecClass *g1dec_class;
 
   gobject_class = (GObjectClass *) klass;
   element_class = (GstElementClass *) klass;
+  video_decoder_class = (GstVideoDecoderClass *) klass;
   g1dec_class = (GstG1BaseDecClass *) klass;
 
   gst_element_class_add_pad_template (element_class,
@@ -109,6 +151,27 @@ gst_g1_jpeg_dec_class_init (GstG1JPEGDecClass * klass)
   gobject_class->set_property = gst_g1_jpeg_dec_set_property;
   gobject_class->get_property = gst_g1_jpeg_dec_get_property;
 
+  g_object_class_install_property (gobject_class, PROP_SLICE_ROWS,
+      g_param_spec_uint ("slice-rows",
+          "Slice Rows",
+          "MCU rows decoded and post processed at once, so large images "
+          "don't need a full size intermediate picture. 0 decodes images "
+          "larger than 8 megapixels in slices of about a megapixel.",
+          0, 1024,
+          PROP_DEFAULT_SLICE_ROWS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DECODE_MODE,
+      g_param_spec_enum ("decode-mode",
+          "Decode Mode",
+          "Whether to decode the full images or their embedded JPEG "
+          "thumbnails, which are much cheaper for previews",
+          GST_G1_JPEG_DEC_MODE_TYPE,
+          PROP_DEFAULT_DECODE_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  video_decoder_class->set_format =
+      GST_DEBUG_FUNCPTR (gst_g1_jpeg_dec_set_format);
+
   g1dec_class->open = GST_DEBUG_FUNCPTR (gst_g1_jpeg_dec_open);
   g1dec_class->close = GST_DEBUG_FUNCPTR (gst_g1_jpeg_dec_close);
   g1dec_class->decode = GST_DEBUG_FUNCPTR (gst_g1_jpeg_dec_decode);
@@ -200,6 +263,14 @@ gst_g1_jpeg_dec_init (GstG1JPEGDec * dec)
 
   GST_LOG_OBJECT (dec, "initializing");
   g1dec->dectype = PP_PIPELINED_DEC_TYPE_JPEG;
+
+  dec->slice_rows = PROP_DEFAULT_SLICE_ROWS;
+  dec->decode_mode = PROP_DEFAULT_DECODE_MODE;
+
+  dec->streaming = FALSE;
+  dec->info_valid = FALSE;
+  dec->fps_start = GST_CLOCK_TIME_NONE;
+  dec->fps_frames = 0;
 }
 
 static gboolean
@@ -229,12 +300,85 @@ static void
 gst_g1_jpeg_dec_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstG1JPEGDec *dec = GST_G1_JPEG_DEC (object);
+
+  GST_OBJECT_LOCK (dec);
+  switch (prop_id) {
+    case PROP_SLICE_ROWS:
+      dec->slice_rows = g_value_get_uint (value);
+      /* Motion JPEG picks the slices from the next headers */
+      dec->info_valid = FALSE;
+      break;
+    case PROP_DECODE_MODE:
+      dec->decode_mode = g_value_get_enum (value);
+      dec->info_valid = FALSE;
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (dec);
 }
 
 static void
 gst_g1_jpeg_dec_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstG1JPEGDec *dec = GST_G1_JPEG_DEC (object);
+
+  GST_OBJECT_LOCK (dec);
+  switch (prop_id) {
+    case PROP_SLICE_ROWS:
+      g_value_set_uint (value, dec->slice_rows);
+      break;
+    case PROP_DECODE_MODE:
+      g_value_set_enum (value, dec->decode_mode);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (dec);
+}
+
+/* MCU rows to decode at once, 0 decodes the whole image in one go */
+static guint
+gst_g1_jpeg_dec_slice_rows (GstG1JPEGDec * dec, JpegDecImageInfo * info)
+{
+  guint rows;
+  guint mcu_height;
+  guint mcu_rows;
+
+  /* The hardware only slices baseline images, progressive and
+     non-interleaved scans cover the whole image */
+  if (JPEGDEC_BASELINE != info->codingMode)
+    return 0;
+
+  GST_OBJECT_LOCK (dec);
+  rows = dec->slice_rows;
+  GST_OBJECT_UNLOCK (dec);
+
+  /* MCUs span two block rows when chroma is subsampled vertically */
+  switch (info->outputFormat) {
+    case JPEGDEC_YCbCr420_SEMIPLANAR:
+    case JPEGDEC_YCbCr440:
+      mcu_height = 16;
+      break;
+    default:
+      mcu_height = 8;
+      break;
+  }
+  mcu_rows = (info->outputHeight + mcu_height - 1) / mcu_height;
+
+  if (!rows) {
+    if (info->outputWidth * info->outputHeight <= JPEG_SLICE_AUTO_PIXELS)
+      return 0;
+
+    rows = MAX (1, JPEG_SLICE_PIXELS / (info->outputWidth * mcu_height));
+  }
+
+  /* A single slice is the whole image */
+  return rows < mcu_rows ? rows : 0;
 }
 
 static void
@@ -267,14 +411,18 @@ gst_g1_jpeg_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
   GstG1JPEGDec *dec = GST_G1_JPEG_DEC (g1dec);
   JpegDecInput jpeginput;
   JpegDecOutput jpegoutput;
-  GstVideoFormatInfo finfoi;
   JpegDecImageInfo imageInfo;
   GstMapInfo minfo;
   JpegDecRet decret;
   GstFlowReturn ret = GST_FLOW_ERROR;
   DWLLinearMem_t linearmem;
   GstVideoCodecState *state;
+  GstG1JPEGDecMode mode;
+  guint32 format;
+  guint32 width;
+  guint32 height;
   gboolean error;
+  gboolean valid;
 
   gst_buffer_map (frame->input_buffer, &minfo, GST_MAP_READ);
   linearmem.virtualAddress = (guint32 *) minfo.data;
@@ -327,39 +475,72 @@ gst_g1_jpeg_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
         imageInfo.outputWidthThumb,
         imageInfo.outputHeightThumb,
         imageInfo.outputFormatThumb, imageInfo.codingModeThumb);
-    if (imageInfo.thumbnailType == JPEGDEC_THUMBNAIL_JPEG) {
+
+    GST_OBJECT_LOCK (dec);
+    mode = dec->decode_mode;
+    valid = dec->info_valid;
+    GST_OBJECT_UNLOCK (dec);
+
+    /* Only JPEG thumbnails can be decoded by the hardware */
+    if (imageInfo.thumbnailType == JPEGDEC_THUMBNAIL_JPEG &&
+        mode != GST_G1_JPEG_DEC_MODE_FULL) {
       GST_LOG_OBJECT (dec, "decImageType = JPEGDEC_THUMBNAIL");
       jpeginput.decImageType = JPEGDEC_THUMBNAIL;
-    } else if (imageInfo.thumbnailType == JPEGDEC_NO_THUMBNAIL) {
-      GST_LOG_OBJECT (dec, "decImageType = JPEGDEC_IMAGE");
-      jpeginput.decImageType = JPEGDEC_IMAGE;
-    } else if (imageInfo.thumbnailType ==
-        JPEGDEC_THUMBNAIL_NOT_SUPPORTED_FORMAT) {
+      format = imageInfo.outputFormatThumb;
+      width = imageInfo.outputWidthThumb;
+      height = imageInfo.outputHeightThumb;
+    } else if (mode == GST_G1_JPEG_DEC_MODE_THUMBNAIL_ONLY) {
+      GST_DEBUG_OBJECT (dec, "no JPEG thumbnail, dropping image");
+      return GST_FLOW_OK;
+    } else {
       GST_LOG_OBJECT (dec, "decImageType = JPEGDEC_IMAGE");
       jpeginput.decImageType = JPEGDEC_IMAGE;
+      format = imageInfo.outputFormat;
+      width = imageInfo.outputWidth;
+      height = imageInfo.outputHeight;
+    }
+
+    /* Motion JPEG frames usually share the geometry of the first one, the
+       output and post processor are configured already */
+    if (valid && dec->image_type == jpeginput.decImageType &&
+        dec->format == format && dec->width == width &&
+        dec->height == height) {
+      jpeginput.sliceMbSet = dec->slice_mb_set;
+      goto decode;
     }
 
     state = gst_video_decoder_get_output_state (dec);
     if (state) {
-      state->info.par_n = imageInfo.outputWidth;
-      state->info.par_d = imageInfo.outputHeight;
-
-      /* A 1 on either field means that it was a range at the time of
-         fixating caps. Likely the user didn't specify them. Use input
-         size */
-      if (1 == state->info.width || 1 == state->info.height) {
-        state->info.width = imageInfo.outputWidth;
-        state->info.height = imageInfo.outputHeight;
-      }
+      state->info.par_n = width;
+      state->info.par_d = height;
+      gst_video_codec_state_unref (state);
     }
 
-    finfoi = gst_format_g1_to_gst (imageInfo.outputFormat);
-    gst_g1_base_dec_config_format (g1dec, &finfoi, imageInfo.outputWidth,
-        imageInfo.outputHeight);
-    GST_LOG_OBJECT (dec, "outputWidth = %d outputHeight = %d\n",
-        imageInfo.outputWidth, imageInfo.outputHeight);
+    gst_g1_base_dec_config_format (g1dec, format, width, height);
+    GST_LOG_OBJECT (dec, "outputWidth = %d outputHeight = %d", width,
+        height);
+
+    /* The post processor scales every slice into its place in the
+       output, the decoder only holds a slice worth of picture */
+    if (JPEGDEC_IMAGE == jpeginput.decImageType)
+      jpeginput.sliceMbSet = gst_g1_jpeg_dec_slice_rows (dec, &imageInfo);
+    if (jpeginput.sliceMbSet)
+      GST_DEBUG_OBJECT (dec, "decoding in slices of %d MCU rows",
+          jpeginput.sliceMbSet);
+  }
+
+  if (dec->streaming) {
+    dec->image_type = jpeginput.decImageType;
+    dec->slice_mb_set = jpeginput.sliceMbSet;
+    dec->format = format;
+    dec->width = width;
+    dec->height = height;
+    GST_OBJECT_LOCK (dec);
+    dec->info_valid = TRUE;
+    GST_OBJECT_UNLOCK (dec);
   }
 
+decode:
   /* reset output */
   jpegoutput.outputPictureY.pVirtualAddress = NULL;
   jpegoutput.outputPictureY.busAddress = 0;
@@ -368,12 +549,14 @@ gst_g1_jpeg_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
   jpegoutput.outputPictureCr.pVirtualAddress = NULL;
   jpegoutput.outputPictureCr.busAddress = 0;
 
-  do {
-
-    ret = gst_g1_base_dec_allocate_output (g1dec, frame);
-    if (GST_FLOW_OK != ret)
-      break;
+  /* Slices and scans all go to the same output buffer */
+  ret = gst_g1_base_dec_allocate_output (g1dec, frame);
+  if (GST_FLOW_OK != ret)
+    return ret;
 
+  /* The decoder keeps the hardware across slices */
+  gst_g1_base_dec_hw_acquire (g1dec, frame);
+  do {
     decret = JpegDecDecode (g1dec->codec, &jpeginput, &jpegoutput);
     switch (decret) {
       case JPEGDEC_SLICE_READY:
@@ -381,7 +564,6 @@ gst_g1_jpeg_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
         break;
       case JPEGDEC_FRAME_READY:
         GST_LOG_OBJECT (dec, "JPEGDEC_FRAME_READY");
-        gst_g1_base_dec_push_data (g1dec, frame);
         ret = GST_FLOW_OK;
         break;
       case JPEGDEC_STRM_PROCESSED:
@@ -421,7 +603,8 @@ gst_g1_jpeg_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
       default:
         GST_ERROR_OBJECT (dec, "Unhandled return code: %s (%d)",
             gst_g1_result_jpeg (decret), decret);
-        g_return_val_if_reached (GST_FLOW_OK);
+        ret = GST_FLOW_ERROR;
+        error = TRUE;
         break;
     }
 
@@ -429,10 +612,81 @@ gst_g1_jpeg_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
       break;
 
   } while (decret != JPEGDEC_FRAME_READY);
+  gst_g1_base_dec_hw_release (g1dec);
+
+  /* The next frame might not be like this one after all */
+  if (error) {
+    GST_OBJECT_LOCK (dec);
+    dec->info_valid = FALSE;
+    GST_OBJECT_UNLOCK (dec);
+    return ret;
+  }
+
+  ret = gst_g1_base_dec_push_data (g1dec, frame);
+
+  if (dec->streaming)
+    gst_g1_jpeg_dec_count_frame (dec);
 
   return ret;
 }
 
+/* Reports the decoding rate of Motion JPEG streams every second */
+static void
+gst_g1_jpeg_dec_count_frame (GstG1JPEGDec * dec)
+{
+  GstClockTime now;
+
+  now = gst_util_get_timestamp ();
+  if (!GST_CLOCK_TIME_IS_VALID (dec->fps_start)) {
+    dec->fps_start = now;
+    dec->fps_frames = 0;
+    return;
+  }
+
+  dec->fps_frames++;
+  if (now - dec->fps_start < GST_SECOND)
+    return;
+
+  GST_CAT_INFO_OBJECT (GST_CAT_PERFORMANCE, dec, "decoding at %.2f fps",
+      (gdouble) dec->fps_frames * GST_SECOND / (now - dec->fps_start));
+
+  dec->fps_start = now;
+  dec->fps_frames = 0;
+}
+
+static gboolean
+gst_g1_jpeg_dec_set_format (GstVideoDecoder * decoder,
+    GstVideoCodecState * state)
+{
+  GstG1JPEGDec *dec = GST_G1_JPEG_DEC (decoder);
+  GstClockTime latency;
+  gint fps_n;
+  gint fps_d;
+
+  fps_n = GST_VIDEO_INFO_FPS_N (&state->info);
+  fps_d = GST_VIDEO_INFO_FPS_D (&state->info);
+
+  /* New caps may bring a new geometry, parse the next headers */
+  dec->streaming = fps_n > 0 && fps_d > 0;
+  GST_OBJECT_LOCK (dec);
+  dec->info_valid = FALSE;
+  GST_OBJECT_UNLOCK (dec);
+  dec->fps_start = GST_CLOCK_TIME_NONE;
+
+  if (!GST_VIDEO_DECODER_CLASS (parent_class)->set_format (decoder, state))
+    return FALSE;
+
+  /* Every frame is decoded as soon as it comes in */
+  if (dec->streaming) {
+    latency = gst_util_uint64_scale_ceil (GST_SECOND, fps_d, fps_n);
+    GST_DEBUG_OBJECT (dec, "Motion JPEG at %d/%d fps, latency %"
+        GST_TIME_FORMAT, fps_n, fps_d, GST_TIME_ARGS (latency));
+    gst_video_decoder_set_latency (decoder, latency, latency);
+  }
+
+  return TRUE;
+}
+
 static gboolean
 gst_g1_jpeg_dec_close (GstG1BaseDec * g1dec)
 {
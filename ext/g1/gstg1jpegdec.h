@@ -34,12 +34,51 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_G1_JPEG_DEC))
 #define GST_IS_G1_JPEG_DEC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_G1_JPEG_DEC))
+/**
+ * What g1jpegdec decodes out of each image.
+ *
+ * @GST_G1_JPEG_DEC_MODE_FULL: The full image.
+ * @GST_G1_JPEG_DEC_MODE_THUMBNAIL_ONLY: The embedded JPEG thumbnail,
+ * images without one are dropped.
+ * @GST_G1_JPEG_DEC_MODE_THUMBNAIL_IF_AVAILABLE: The embedded JPEG
+ * thumbnail, or the full image if there is none.
+ */
+typedef enum
+{
+  GST_G1_JPEG_DEC_MODE_FULL,
+  GST_G1_JPEG_DEC_MODE_THUMBNAIL_ONLY,
+  GST_G1_JPEG_DEC_MODE_THUMBNAIL_IF_AVAILABLE,
+} GstG1JPEGDecMode;
+
+#define GST_G1_JPEG_DEC_MODE_TYPE (gst_g1_jpeg_dec_mode_get_type())
+GType gst_g1_jpeg_dec_mode_get_type (void);
+
 typedef struct _GstG1JPEGDec GstG1JPEGDec;
 typedef struct _GstG1JPEGDecClass GstG1JPEGDecClass;
 
 struct _GstG1JPEGDec
 {
   GstG1BaseDec parent;
+
+  /* MCU rows decoded at once, 0 picks them from the image size */
+  guint slice_rows;
+
+  GstG1JPEGDecMode decode_mode;
+
+  /* Motion JPEG: input with a framerate, whose output and post
+     processor are configured once for as long as the picture geometry
+     doesn't change, and the decoding rate measured over the last
+     second. info_valid is guarded by the object lock, properties clear
+     it */
+  gboolean streaming;
+  gboolean info_valid;
+  guint32 image_type;
+  guint32 slice_mb_set;
+  guint32 format;
+  guint32 width;
+  guint32 height;
+  GstClockTime fps_start;
+  guint fps_frames;
 };
 
 struct _GstG1JPEGDecClass
@@ -92,6 +92,7 @@ static void gst_g1_mp4_dec_set_property (GObject * object, guint prop_id,
 static gboolean gst_g1_mp4_dec_open (GstG1BaseDec * dec);
 
 static gboolean gst_g1_mp4_dec_close (GstG1BaseDec * dec);
+static GstFlowReturn gst_g1_mp4_dec_drain (GstG1BaseDec * dec);
 
 static GstFlowReturn gst_g1_mp4_dec_decode_header (GstG1BaseDec * g1dec,
     GstBuffer * streamheader);
@@ -100,7 +101,8 @@ static GstFlowReturn gst_g1_mp4_dec_decode (GstG1BaseDec * decoder,
     GstVideoCodecFrame * frame);
 
 static void gst_g1_mp4_dec_dwl_to_mp4 (GstG1MP4Dec * dec,
-    DWLLinearMem_t * linearmem, MP4DecInput * input, gsize size);
+    DWLLinearMem_t * linearmem, MP4DecInput * input, gsize size,
+    guint32 picid);
 
 static void
 gst_g1_mp4_dec_class_init (GstG1MP4DecClass * klass)
@@ -159,6 +161,7 @@ gst_g1_mp4_dec_class_init (GstG1MP4DecClass * klass)
   g1dec_class->open = GST_DEBUG_FUNCPTR (gst_g1_mp4_dec_open);
   g1dec_class->close = GST_DEBUG_FUNCPTR (gst_g1_mp4_dec_close);
   g1dec_class->decode = GST_DEBUG_FUNCPTR (gst_g1_mp4_dec_decode);
+  g1dec_class->drain = GST_DEBUG_FUNCPTR (gst_g1_mp4_dec_drain);
   g1dec_class->decode_header = GST_DEBUG_FUNCPTR (gst_g1_mp4_dec_decode_header);
 
 
@@ -178,7 +181,6 @@ gst_g1_mp4_dec_init (GstG1MP4Dec * dec)
   dec->skip_non_reference = PROP_DEFAULT_SKIP_NON_REFERENCE;
   dec->error_concealment = PROP_DEFAULT_ERROR_CONCEALMENT;
   dec->numFrameBuffers = PROP_DEFAULT_NUM_FRAMEBUFFER;
-  dec->picDecodeNumber = 0;
 }
 
 static gboolean
@@ -219,7 +221,7 @@ gst_g1_mp4_dec_set_property (GObject * object, guint prop_id,
       dec->error_concealment = g_value_get_boolean (value);
       break;
     case PROP_NUM_FRAMEBUFFER:
-      dec->numFrameBuffers = g_value_get_int (value);
+      dec->numFrameBuffers = g_value_get_uint (value);
       break;
     case PROP_SKIP_NON_REFERENCE:
       dec->skip_non_reference = g_value_get_boolean (value);
@@ -241,7 +243,7 @@ gst_g1_mp4_dec_get_property (GObject * object, guint prop_id,
       g_value_set_boolean (value, dec->error_concealment);
       break;
     case PROP_NUM_FRAMEBUFFER:
-      g_value_set_int (value, dec->numFrameBuffers);
+      g_value_set_uint (value, dec->numFrameBuffers);
       break;
     case PROP_SKIP_NON_REFERENCE:
       g_value_set_boolean (value, dec->skip_non_reference);
@@ -258,7 +260,6 @@ gst_g1_mp4_dec_parse_header (GstG1MP4Dec * dec)
   GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
   GstG1BaseDec *g1dec = GST_G1_BASE_DEC (dec);
   GstFlowReturn ret = GST_FLOW_OK;
-  GstVideoFormatInfo finfoi;
   GstVideoCodecState *state;
   MP4DecInfo header;
   MP4DecRet decret;
@@ -305,26 +306,21 @@ gst_g1_mp4_dec_parse_header (GstG1MP4Dec * dec)
   if (state) {
     state->info.par_n = header.parWidth;
     state->info.par_d = header.parHeight;
-
-    /* A 1 on either field means that it was a range at the time of
-       fixating caps. Likely the user didn't specify them. Use input
-       size */
-    if (1 == state->info.width || 1 == state->info.height) {
-      state->info.width = header.frameWidth;
-      state->info.height = header.frameHeight;
-    }
   }
 
-  finfoi = gst_format_g1_to_gst (header.outputFormat);
-  gst_g1_base_dec_config_format (g1dec, &finfoi, header.frameWidth,
-      header.frameHeight);
+  gst_g1_base_dec_config_interlaced (g1dec, header.interlacedSequence);
+  gst_g1_base_dec_config_format (g1dec, header.outputFormat,
+      header.frameWidth, header.frameHeight);
+  gst_g1_base_dec_config_buffers (g1dec, dec->numFrameBuffers,
+      header.multiBuffPpSize);
 exit:
   return ret;
 }
 
 static void
 gst_g1_mp4_dec_dwl_to_mp4 (GstG1MP4Dec * dec,
-    DWLLinearMem_t * linearmem, MP4DecInput * mp4input, gsize size)
+    DWLLinearMem_t * linearmem, MP4DecInput * mp4input, gsize size,
+    guint32 picid)
 {
   gboolean skip_non_reference;
 
@@ -340,37 +336,55 @@ gst_g1_mp4_dec_dwl_to_mp4 (GstG1MP4Dec * dec,
   mp4input->dataLen = size;
   mp4input->streamBusAddress = linearmem->busAddress;
 
-  mp4input->picId = 0;
+  mp4input->picId = picid;
   mp4input->skipNonReference = skip_non_reference;
 }
 
 static GstFlowReturn
-gst_g1_mp4_dec_pop_picture (GstG1MP4Dec * dec, GstVideoCodecFrame * frame)
+gst_g1_mp4_dec_pop_picture (GstG1MP4Dec * dec, gboolean eos)
 {
   GstG1BaseDec *bdec;
   MP4DecPicture picture;
   MP4DecRet decret;
+  GstFlowReturn ret;
+  guint n = 0;
 
   bdec = GST_G1_BASE_DEC (dec);
 
+  ret = GST_FLOW_OK;
   do {
-    decret = MP4DecNextPicture (bdec->codec, &picture, FALSE);
+    /* Every picture gets post processed into its own buffer, unless
+       it is dropped */
+    if (!bdec->output_buffer && !bdec->pp_skipped) {
+      ret = gst_g1_base_dec_allocate_output (bdec, NULL);
+      if (GST_FLOW_OK != ret || !bdec->output_buffer)
+        break;
+    }
+
+    decret = MP4DecNextPicture (bdec->codec, &picture, eos);
     if (decret != MP4DEC_PIC_RDY) {
-      GST_ERROR_OBJECT (dec, "%s (%d) (%p|0x%08x)",
+      GST_LOG_OBJECT (dec, "%s (%d) (%p|0x%08x)",
           gst_g1_result_mp4 (decret), decret, picture.pOutputPicture,
           picture.outputPictureBusAddress);
       break;
     }
     /* TODO: do some error checking here */
 
-    if (picture.nbrOfErrMBs)
+    if (picture.nbrOfErrMBs) {
       GST_LOG_OBJECT (dec, "concealed %d macroblocks", picture.nbrOfErrMBs);
+      gst_g1_base_dec_count (GST_G1_BASE_DEC (dec),
+          GST_G1_BASE_DEC_CONCEALED_MBS, picture.nbrOfErrMBs);
+    }
 
-    gst_g1_base_dec_push_data (bdec, frame);
+    ret = gst_g1_base_dec_push_picture (bdec, picture.picId);
 
-  } while (decret == MP4DEC_PIC_RDY);
+  } while (decret == MP4DEC_PIC_RDY && GST_FLOW_OK == ret &&
+      ++n < GST_G1_BASE_DEC_MAX_PICTURES);
 
-  return GST_FLOW_OK;
+  if (n == GST_G1_BASE_DEC_MAX_PICTURES)
+    GST_WARNING_OBJECT (dec, "decoder keeps returning pictures, giving up");
+
+  return ret;
 }
 
 static GstFlowReturn
@@ -390,9 +404,11 @@ gst_g1_mp4_dec_decode_header (GstG1BaseDec * g1dec, GstBuffer * streamheader)
   linearmem.size = minfo.size;
   gst_buffer_unmap (streamheader, &minfo);
 
-  gst_g1_mp4_dec_dwl_to_mp4 (dec, &linearmem, &mp4input, minfo.size);
+  gst_g1_mp4_dec_dwl_to_mp4 (dec, &linearmem, &mp4input, minfo.size, 0);
 
+  gst_g1_base_dec_hw_acquire (g1dec, NULL);
   decret = MP4DecDecode (g1dec->codec, &mp4input, &mp4output);
+  gst_g1_base_dec_hw_release (g1dec);
   switch (decret) {
     case MP4DEC_HDRS_RDY:
     case MP4DEC_DP_HDRS_RDY:
@@ -426,16 +442,21 @@ gst_g1_mp4_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
   linearmem.size = minfo.size;
   gst_buffer_unmap (frame->input_buffer, &minfo);
 
-  gst_g1_mp4_dec_dwl_to_mp4 (dec, &linearmem, &mp4input, minfo.size);
+  gst_g1_mp4_dec_dwl_to_mp4 (dec, &linearmem, &mp4input, minfo.size,
+      frame->system_frame_number);
+
+  /* Catch up by not decoding what nothing else depends on */
+  if (gst_g1_base_dec_skip_non_reference (g1dec, frame))
+    mp4input.skipNonReference = TRUE;
 
   do {
     ret = gst_g1_base_dec_allocate_output (g1dec, frame);
     if (ret != GST_FLOW_OK)
       break;
 
-    mp4input.picId = dec->picDecodeNumber;
-
+    gst_g1_base_dec_hw_acquire (g1dec, frame);
     decret = MP4DecDecode (g1dec->codec, &mp4input, &mp4output);
+    gst_g1_base_dec_hw_release (g1dec);
     switch (decret) {
       case MP4DEC_HDRS_RDY:
       case MP4DEC_DP_HDRS_RDY:
@@ -446,8 +467,9 @@ gst_g1_mp4_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
         /* a picture was decoded */
       case MP4DEC_PIC_DECODED:
         GST_LOG_OBJECT (dec, "MP4DEC_PIC_DECODED");
-        dec->picDecodeNumber++;
-        ret = gst_g1_mp4_dec_pop_picture (dec, frame);
+        /* B-VOPs make pictures come out in a different order */
+        gst_g1_base_dec_queue_picture (g1dec, frame);
+        ret = gst_g1_mp4_dec_pop_picture (dec, FALSE);
         break;
       case MP4DEC_STRM_PROCESSED:
         GST_LOG_OBJECT (dec, "Frame successfully processed");
@@ -496,6 +518,15 @@ gst_g1_mp4_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
   return ret;
 }
 
+static GstFlowReturn
+gst_g1_mp4_dec_drain (GstG1BaseDec * g1dec)
+{
+  GstG1MP4Dec *dec = GST_G1_MP4_DEC (g1dec);
+
+  /* The last reference VOP is held back until the stream ends */
+  return gst_g1_mp4_dec_pop_picture (dec, TRUE);
+}
+
 static gboolean
 gst_g1_mp4_dec_close (GstG1BaseDec * g1dec)
 {
@@ -42,7 +42,6 @@ struct _GstG1MP4Dec
   gboolean skip_non_reference;
   gboolean error_concealment;
   u32 numFrameBuffers;
-  u32 picDecodeNumber;          /* decoded picture ID */
 };
 
 struct _GstG1MP4DecClass
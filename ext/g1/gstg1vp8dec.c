@@ -74,6 +74,7 @@ static void gst_g1_vp8_dec_set_property (GObject * object, guint prop_id,
 
 static gboolean gst_g1_vp8_dec_open (GstG1BaseDec * dec);
 static gboolean gst_g1_vp8_dec_close (GstG1BaseDec * dec);
+static GstFlowReturn gst_g1_vp8_dec_drain (GstG1BaseDec * dec);
 static GstFlowReturn gst_g1_vp8_dec_decode_headers (GstG1BaseDec * g1dec,
     GstBuffer * streamheader);
 static GstFlowReturn gst_g1_vp8_dec_decode (GstG1BaseDec * decoder,
@@ -127,6 +128,7 @@ gst_g1_vp8_dec_class_init (GstG1VP8DecClass * klass)
   g1dec_class->open = GST_DEBUG_FUNCPTR (gst_g1_vp8_dec_open);
   g1dec_class->close = GST_DEBUG_FUNCPTR (gst_g1_vp8_dec_close);
   g1dec_class->decode = GST_DEBUG_FUNCPTR (gst_g1_vp8_dec_decode);
+  g1dec_class->drain = GST_DEBUG_FUNCPTR (gst_g1_vp8_dec_drain);
   g1dec_class->decode_header =
       GST_DEBUG_FUNCPTR (gst_g1_vp8_dec_decode_headers);
 
@@ -211,11 +213,8 @@ gst_g1_vp8_dec_get_property (GObject * object, guint prop_id,
 static GstFlowReturn
 gst_g1_vp8_dec_parse_header (GstG1VP8Dec * dec)
 {
-  GstVideoDecoder *bdec = GST_VIDEO_DECODER (dec);
   GstG1BaseDec *g1dec = GST_G1_BASE_DEC (dec);
   GstFlowReturn ret;
-  GstVideoFormatInfo finfoi;
-  GstVideoCodecState *state;
   VP8DecInfo header;
   VP8DecRet decret;
 
@@ -249,18 +248,7 @@ gst_g1_vp8_dec_parse_header (GstG1VP8Dec * dec)
       header.scaledWidth,
       header.scaledHeight, header.dpbMode, header.outputFormat);
 
-  state = gst_video_decoder_get_output_state (bdec);
-  if (state) {
-    /* A 1 on either field means that it was a range at the time of fixating
-     * caps. Likely the user didn't specify them. Use input size */
-    if (1 == state->info.width || 1 == state->info.height) {
-      state->info.width = header.frameWidth;
-      state->info.height = header.frameHeight;
-    }
-  }
-
-  finfoi = gst_format_g1_to_gst (header.outputFormat);
-  gst_g1_base_dec_config_format (g1dec, &finfoi,
+  gst_g1_base_dec_config_format (g1dec, header.outputFormat,
       header.frameWidth, header.frameHeight);
 
   ret = GST_FLOW_OK;
@@ -297,24 +285,23 @@ gst_g1_vp8_dec_pop_picture (GstG1VP8Dec * dec, GstVideoCodecFrame * frame)
 
   bdec = GST_G1_BASE_DEC (dec);
 
-  do {
-    decret = VP8DecNextPicture (bdec->codec, &picture, FALSE);
-    if (decret != VP8DEC_PIC_RDY) {
-      GST_ERROR_OBJECT (dec, "%s (%d) (%p|0x%08x)",
-          gst_g1_result_vp8 (decret), decret, picture.pOutputFrame,
-          picture.outputFrameBusAddress);
-      break;
-    }
-    /* TODO: do some error checking here */
-
-    if (picture.nbrOfErrMBs)
-      GST_LOG_OBJECT (dec, "concealed %d macroblocks", picture.nbrOfErrMBs);
-
-    gst_g1_base_dec_push_data (bdec, frame);
+  /* VP8 doesn't reorder, a decoded frame gives exactly one picture */
+  decret = VP8DecNextPicture (bdec->codec, &picture, FALSE);
+  if (decret != VP8DEC_PIC_RDY) {
+    GST_ERROR_OBJECT (dec, "%s (%d) (%p|0x%08x)",
+        gst_g1_result_vp8 (decret), decret, picture.pOutputFrame,
+        picture.outputFrameBusAddress);
+    return GST_FLOW_OK;
+  }
+  /* TODO: do some error checking here */
 
-  } while (decret == VP8DEC_PIC_RDY);
+  if (picture.nbrOfErrMBs) {
+    GST_LOG_OBJECT (dec, "concealed %d macroblocks", picture.nbrOfErrMBs);
+    gst_g1_base_dec_count (GST_G1_BASE_DEC (dec),
+        GST_G1_BASE_DEC_CONCEALED_MBS, picture.nbrOfErrMBs);
+  }
 
-  return GST_FLOW_OK;
+  return gst_g1_base_dec_push_data (bdec, frame);
 }
 
 static GstFlowReturn
@@ -338,7 +325,9 @@ gst_g1_vp8_dec_decode_headers (GstG1BaseDec * g1dec, GstBuffer * streamheader)
 
   gst_util_dump_mem (vp8input.pStream, minfo.size);
 
+  gst_g1_base_dec_hw_acquire (g1dec, NULL);
   decret = VP8DecDecode (g1dec->codec, &vp8input, &vp8output);
+  gst_g1_base_dec_hw_release (g1dec);
   switch (decret) {
     case VP8DEC_HDRS_RDY:
       /* read stream info */
@@ -380,7 +369,9 @@ gst_g1_vp8_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
     if (GST_FLOW_OK != ret)
       break;
 
+    gst_g1_base_dec_hw_acquire (g1dec, frame);
     decret = VP8DecDecode (g1dec->codec, &vp8input, &vp8output);
+    gst_g1_base_dec_hw_release (g1dec);
     switch (decret) {
       case VP8DEC_SLICE_RDY:
         GST_LOG_OBJECT (dec, "VP8DEC_SLICE_RDY");
@@ -429,6 +420,31 @@ gst_g1_vp8_dec_decode (GstG1BaseDec * g1dec, GstVideoCodecFrame * frame)
   return ret;
 }
 
+static GstFlowReturn
+gst_g1_vp8_dec_drain (GstG1BaseDec * g1dec)
+{
+  GstG1VP8Dec *dec = GST_G1_VP8_DEC (g1dec);
+  VP8DecPicture picture;
+  VP8DecRet decret;
+  gboolean skipped;
+
+  /* VP8 doesn't reorder, every picture was pushed along with its frame.
+     Release the last one the decoder holds without post processing it
+     into a buffer again. */
+  skipped = g1dec->pp_skipped;
+  if (!skipped && !gst_g1_base_dec_skip_pictures (g1dec, TRUE))
+    return GST_FLOW_ERROR;
+
+  decret = VP8DecNextPicture (g1dec->codec, &picture, TRUE);
+  if (decret == VP8DEC_PIC_RDY)
+    GST_DEBUG_OBJECT (dec, "discarding picture already output");
+
+  if (!skipped)
+    gst_g1_base_dec_skip_pictures (g1dec, FALSE);
+
+  return GST_FLOW_OK;
+}
+
 static gboolean
 gst_g1_vp8_dec_close (GstG1BaseDec * g1dec)
 {
@@ -0,0 +1,221 @@
+/* GStreamer G1 plugin
+ *
+ * Copyright (C) 2026 Microchip Technology Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "gstg1bufferpool.h"
+#include "gstdwlallocator.h"
+#include "gstg1format.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_g1_buffer_pool_debug);
+#define GST_CAT_DEFAULT gst_g1_buffer_pool_debug
+
+#define gst_g1_buffer_pool_parent_class parent_class
+G_DEFINE_TYPE (GstG1BufferPool, gst_g1_buffer_pool, GST_TYPE_BUFFER_POOL);
+
+static const gchar **gst_g1_buffer_pool_get_options (GstBufferPool * pool);
+static gboolean gst_g1_buffer_pool_set_config (GstBufferPool * pool,
+    GstStructure * config);
+static GstFlowReturn gst_g1_buffer_pool_alloc_buffer (GstBufferPool * pool,
+    GstBuffer ** buffer, GstBufferPoolAcquireParams * params);
+static void gst_g1_buffer_pool_finalize (GObject * object);
+
+static void
+gst_g1_buffer_pool_class_init (GstG1BufferPoolClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstBufferPoolClass *pool_class;
+
+  gobject_class = (GObjectClass *) klass;
+  pool_class = (GstBufferPoolClass *) klass;
+
+  gobject_class->finalize = gst_g1_buffer_pool_finalize;
+
+  pool_class->get_options = GST_DEBUG_FUNCPTR (gst_g1_buffer_pool_get_options);
+  pool_class->set_config = GST_DEBUG_FUNCPTR (gst_g1_buffer_pool_set_config);
+  pool_class->alloc_buffer =
+      GST_DEBUG_FUNCPTR (gst_g1_buffer_pool_alloc_buffer);
+
+  GST_DEBUG_CATEGORY_INIT (gst_g1_buffer_pool_debug, "g1bufferpool",
+      0, "G1 Buffer Pool");
+}
+
+static void
+gst_g1_buffer_pool_init (GstG1BufferPool * pool)
+{
+  GST_DEBUG_OBJECT (pool, "init pool %p", pool);
+
+  pool->allocator = NULL;
+  pool->params = (const GstAllocationParams) { 0 };
+  gst_video_info_init (&pool->vinfo);
+  pool->size = 0;
+  pool->add_videometa = FALSE;
+}
+
+static void
+gst_g1_buffer_pool_finalize (GObject * object)
+{
+  GstG1BufferPool *pool = GST_G1_BUFFER_POOL (object);
+
+  if (pool->allocator) {
+    gst_object_unref (pool->allocator);
+    pool->allocator = NULL;
+  }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+GstBufferPool *
+gst_g1_buffer_pool_new (void)
+{
+  return g_object_new (GST_TYPE_G1_BUFFER_POOL, NULL);
+}
+
+static const gchar **
+gst_g1_buffer_pool_get_options (GstBufferPool * pool)
+{
+  static const gchar *options[] = { GST_BUFFER_POOL_OPTION_VIDEO_META, NULL };
+
+  return options;
+}
+
+static gboolean
+gst_g1_buffer_pool_set_config (GstBufferPool * pool, GstStructure * config)
+{
+  GstG1BufferPool *g1pool = GST_G1_BUFFER_POOL (pool);
+  GstAllocator *allocator;
+  GstAllocationParams params;
+  GstVideoInfo vinfo;
+  GstCaps *caps;
+  gboolean raw;
+  guint size, min, max;
+
+  if (!gst_buffer_pool_config_get_params (config, &caps, &size, &min, &max)) {
+    GST_WARNING_OBJECT (pool, "invalid config");
+    return FALSE;
+  }
+
+  if (!caps) {
+    GST_WARNING_OBJECT (pool, "no caps in config");
+    return FALSE;
+  }
+
+  raw = gst_structure_has_name (gst_caps_get_structure (caps, 0),
+      "video/x-raw");
+
+  if (raw) {
+    if (!gst_video_info_from_caps (&vinfo, caps)) {
+      GST_WARNING_OBJECT (pool, "failed getting geometry from caps %"
+          GST_PTR_FORMAT, caps);
+      return FALSE;
+    }
+
+    /* Lay the planes out the way the post processor writes them */
+    gst_format_g1_align (&vinfo);
+  } else {
+    /* Compressed bitstream, only the size is meaningful */
+    gst_video_info_init (&vinfo);
+    if (!size) {
+      GST_WARNING_OBJECT (pool, "no size for caps %" GST_PTR_FORMAT, caps);
+      return FALSE;
+    }
+  }
+
+  allocator = NULL;
+  gst_buffer_pool_config_get_allocator (config, &allocator, &params);
+
+  /* Only G1 memory can be handed to the hardware */
+  if (allocator && GST_IS_G1_ALLOCATOR (allocator)) {
+    gst_object_ref (allocator);
+  } else {
+    GST_DEBUG_OBJECT (pool, "using default " GST_ALLOCATOR_DWL " allocator");
+    allocator = gst_allocator_find (GST_ALLOCATOR_DWL);
+    params = (const GstAllocationParams) { 0 };
+  }
+
+  if (!allocator) {
+    GST_WARNING_OBJECT (pool, "no valid allocator in pool");
+    return FALSE;
+  }
+
+  if (g1pool->allocator)
+    gst_object_unref (g1pool->allocator);
+  g1pool->allocator = allocator;
+
+  params.flags |= GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
+  g1pool->params = params;
+
+  size = MAX (size, vinfo.size);
+  g1pool->vinfo = vinfo;
+  g1pool->size = size;
+
+  g1pool->add_videometa = raw && gst_buffer_pool_config_has_option (config,
+      GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+  GST_DEBUG_OBJECT (pool, "configured %d buffers of %d bytes (max %d)",
+      min, size, max);
+
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+  gst_buffer_pool_config_set_allocator (config, allocator, &params);
+
+  return GST_BUFFER_POOL_CLASS (parent_class)->set_config (pool, config);
+}
+
+static GstFlowReturn
+gst_g1_buffer_pool_alloc_buffer (GstBufferPool * pool, GstBuffer ** buffer,
+    GstBufferPoolAcquireParams * params)
+{
+  GstG1BufferPool *g1pool = GST_G1_BUFFER_POOL (pool);
+  GstVideoInfo *vinfo = &g1pool->vinfo;
+  GstMemory *mem;
+
+  mem = gst_allocator_alloc (g1pool->allocator, g1pool->size, &g1pool->params);
+  if (!mem) {
+    GST_WARNING_OBJECT (pool, "unable to allocate %d bytes", g1pool->size);
+    return GST_FLOW_ERROR;
+  }
+
+  *buffer = gst_buffer_new ();
+  gst_buffer_append_memory (*buffer, mem);
+
+  if (g1pool->add_videometa) {
+    gst_buffer_add_video_meta_full (*buffer, GST_VIDEO_FRAME_FLAG_NONE,
+        GST_VIDEO_INFO_FORMAT (vinfo),
+        GST_VIDEO_INFO_WIDTH (vinfo), GST_VIDEO_INFO_HEIGHT (vinfo),
+        GST_VIDEO_INFO_N_PLANES (vinfo), vinfo->offset, vinfo->stride);
+  }
+
+  GST_LOG_OBJECT (pool, "allocated buffer %p, physical: 0x%08x", *buffer,
+      gst_g1_allocator_get_physical (mem));
+
+  return GST_FLOW_OK;
+}
+
+guint32
+gst_g1_buffer_pool_get_physical (GstBuffer * buffer)
+{
+  GstMemory *mem;
+
+  g_return_val_if_fail (buffer, 0);
+
+  if (!gst_buffer_n_memory (buffer))
+    return 0;
+
+  mem = gst_buffer_peek_memory (buffer, 0);
+  if (!GST_IS_G1_ALLOCATOR (mem->allocator))
+    return 0;
+
+  return gst_g1_allocator_get_physical (mem);
+}
@@ -0,0 +1,83 @@
+/* GStreamer G1 plugin
+ *
+ * Copyright (C) 2026 Microchip Technology Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _GST_G1_BUFFER_POOL_H_
+#define _GST_G1_BUFFER_POOL_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gstg1allocator.h"
+
+G_BEGIN_DECLS
+#define GST_TYPE_G1_BUFFER_POOL \
+  (gst_g1_buffer_pool_get_type())
+#define GST_IS_G1_BUFFER_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_G1_BUFFER_POOL))
+#define GST_IS_G1_BUFFER_POOL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_G1_BUFFER_POOL))
+#define GST_G1_BUFFER_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_G1_BUFFER_POOL,GstG1BufferPool))
+#define GST_G1_BUFFER_POOL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_G1_BUFFER_POOL,GstG1BufferPoolClass))
+typedef struct _GstG1BufferPool GstG1BufferPool;
+typedef struct _GstG1BufferPoolClass GstG1BufferPoolClass;
+
+struct _GstG1BufferPool
+{
+  GstBufferPool parent;
+
+  GstAllocator *allocator;
+  GstAllocationParams params;
+  GstVideoInfo vinfo;
+  guint size;
+  gboolean add_videometa;
+};
+
+struct _GstG1BufferPoolClass
+{
+  GstBufferPoolClass parent_class;
+};
+
+GType gst_g1_buffer_pool_get_type (void);
+
+/**
+ * Creates a new pool of physically contiguous buffers. Buffers are
+ * allocated once, when the pool is activated, and recycled afterwards,
+ * so their physical addresses remain valid for the lifetime of the
+ * pool. Raw video buffers are sized from the configured caps, padded to
+ * 16 pixels, and carry a GstVideoMeta describing the plane layout when
+ * the GST_BUFFER_POOL_OPTION_VIDEO_META option is set. For compressed
+ * caps the configured size is used as is.
+ *
+ * @return A new GstBufferPool
+ */
+GstBufferPool *gst_g1_buffer_pool_new (void);
+
+/**
+ * Returns the physical address of the first memory in the buffer
+ *
+ * @param buffer A buffer acquired from a GstG1BufferPool or any other
+ * buffer whose memory was allocated by a G1 allocator.
+ *
+ * @return The physical address of the data or 0 if the buffer memory
+ * was not allocated by a G1 allocator.
+ */
+guint32 gst_g1_buffer_pool_get_physical (GstBuffer * buffer);
+
+G_END_DECLS
+#endif /*_GST_G1_BUFFER_POOL_H_*/
@@ -33,6 +33,8 @@ static GstMemory *gst_dwl_allocator_alloc (GstAllocator * allocator, gsize size,
     GstAllocationParams * params);
 static void gst_dwl_allocator_free (GstAllocator * allocator,
     GstMemory * memory);
+static GstMemory *gst_dwl_allocator_share (GstMemory * mem, gssize offset,
+    gssize size);
 
 #define GST_DWL_ALLOCATOR(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_DWL_ALLOCATOR,GstDwlAllocator))
@@ -44,6 +46,11 @@ typedef struct _GstDwlMemory
   GstG1Memory mem;
 
   DWLLinearMem_t linearmem;
+
+  /* Wrapped memories belong to someone else, who is notified when they
+     are released */
+  gpointer user_data;
+  GDestroyNotify notify;
 } GstDwlMemory;
 
 typedef struct
@@ -100,10 +107,14 @@ gst_dwl_allocator_class_init (GstDwlAllocatorClass * klass)
 static void
 gst_dwl_allocator_init (GstDwlAllocator * allocator)
 {
+  GstAllocator *alloc = GST_ALLOCATOR (allocator);
   DWLInitParam_t params;
 
   GST_CAT_DEBUG (GST_CAT_MEMORY, "init allocator %p", allocator);
 
+  /* Upstream elements may split buffers allocated from our pools */
+  alloc->mem_share = GST_DEBUG_FUNCPTR (gst_dwl_allocator_share);
+
   /* Use H264 as client, not really needed for anything but as a container */
   params.clientType = DWL_CLIENT_TYPE_H264_DEC;
   allocator->dwl = DWLInit (&params);
@@ -143,6 +154,9 @@ gst_dwl_allocator_alloc (GstAllocator * allocator, gsize size,
   gst_memory_init (mem, GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS, _dwl_allocator,
       NULL, maxsize, 0, params->prefix, size);
 
+  dwlmem->user_data = NULL;
+  dwlmem->notify = NULL;
+
   g1mem = (GstG1Memory *) dwlmem;
   g1mem->virtaddress = dwlmem->linearmem.virtualAddress;
   g1mem->physaddress = dwlmem->linearmem.busAddress;
@@ -166,6 +180,74 @@ gst_dwl_allocator_free (GstAllocator * allocator, GstMemory * mem)
 
   GST_LOG ("Freeing slice %p", mem);
 
-  DWLFreeLinear (dwl->dwl, &dwlmem->linearmem);
+  /* Shared memories don't own the linear block, their parent does */
+  if (mem->parent)
+    GST_LOG ("Parent owns slice %p", mem);
+  else if (dwlmem->notify)
+    dwlmem->notify (dwlmem->user_data);
+  else
+    DWLFreeLinear (dwl->dwl, &dwlmem->linearmem);
   g_slice_free (GstDwlMemory, dwlmem);
 }
+
+static GstMemory *
+gst_dwl_allocator_share (GstMemory * mem, gssize offset, gssize size)
+{
+  GstDwlMemory *dwlmem;
+  GstDwlMemory *sub;
+  GstMemory *parent;
+
+  dwlmem = (GstDwlMemory *) mem;
+
+  if (size == -1)
+    size = mem->size - offset;
+
+  /* Always share the memory that actually owns the linear block */
+  parent = mem->parent ? mem->parent : mem;
+
+  sub = g_slice_new (GstDwlMemory);
+
+  gst_memory_init (GST_MEMORY_CAST (sub),
+      GST_MINI_OBJECT_FLAGS (parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY,
+      mem->allocator, parent, mem->maxsize, mem->align, mem->offset + offset,
+      size);
+
+  sub->mem.virtaddress = dwlmem->mem.virtaddress;
+  sub->mem.physaddress = dwlmem->mem.physaddress;
+  sub->linearmem = dwlmem->linearmem;
+  sub->user_data = NULL;
+  sub->notify = NULL;
+
+  GST_LOG ("Sharing slice %p as %p at offset %d", mem, sub, offset);
+
+  return GST_MEMORY_CAST (sub);
+}
+
+GstMemory *
+gst_dwl_allocator_wrap (gpointer virtaddress, guint32 physaddress, gsize size,
+    gpointer user_data, GDestroyNotify notify)
+{
+  GstDwlMemory *dwlmem;
+  GstMemory *mem;
+
+  g_return_val_if_fail (_dwl_allocator, NULL);
+  g_return_val_if_fail (virtaddress, NULL);
+  g_return_val_if_fail (physaddress, NULL);
+
+  dwlmem = g_slice_new0 (GstDwlMemory);
+  mem = GST_MEMORY_CAST (dwlmem);
+
+  /* Whoever owns the block keeps writing into it once released */
+  gst_memory_init (mem, GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS |
+      GST_MEMORY_FLAG_READONLY, _dwl_allocator, NULL, size, 0, 0, size);
+
+  dwlmem->mem.virtaddress = virtaddress;
+  dwlmem->mem.physaddress = physaddress;
+  dwlmem->user_data = user_data;
+  dwlmem->notify = notify;
+
+  GST_LOG ("Wrapping 0x%08x in slice %p of %" G_GSIZE_FORMAT, physaddress,
+      mem, size);
+
+  return mem;
+}
@@ -41,5 +41,22 @@ GType gst_dwl_allocator_get_type (void);
  */
 void gst_dwl_allocator_new (void);
 
+/**
+ * Wraps a physically contiguous block owned by someone else, such as a
+ * picture buffer of a G1 codec, in a read only memory of the DWL
+ * allocator.
+ *
+ * @param virtaddress The virtual address of the block
+ * @param physaddress The physical address of the block
+ * @param size The size of the block
+ * @param user_data Data passed to notify
+ * @param notify Called when the memory is freed, so the owner can reuse
+ * the block
+ *
+ * @return A new GstMemory or NULL if the allocator isn't registered
+ */
+GstMemory *gst_dwl_allocator_wrap (gpointer virtaddress, guint32 physaddress,
+    gsize size, gpointer user_data, GDestroyNotify notify);
+
 G_END_DECLS
 #endif /*_GST_DWL_ALLOCATOR_H_*/
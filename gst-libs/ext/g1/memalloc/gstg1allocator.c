@@ -83,6 +83,7 @@ gst_g1_allocator_get_physical (GstMemory * mem)
 
   g_return_val_if_fail (GST_IS_G1_ALLOCATOR (mem->allocator), 0);
 
+  /* Shared sub-memories point somewhere inside the parent block */
   g1mem = (GstG1Memory *) mem;
-  return g1mem->physaddress;
+  return g1mem->physaddress + mem->offset;
 }
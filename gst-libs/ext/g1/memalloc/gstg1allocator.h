@@ -62,8 +62,8 @@ GType gst_g1_allocator_get_type (void);
  * @param mem The GstMemory to query the physical address from. This
  * memory must have been allocated with the GstG1Allocator or subclass.
  *
- * @return The physical address of the data or 0 if the mem was not
- * allocated by a G1 allocator.
+ * @return The physical address of the data (taking the memory offset
+ * into account) or 0 if the mem was not allocated by a G1 allocator.
  */
 guint32 gst_g1_allocator_get_physical (GstMemory * mem);
 
@@ -0,0 +1,244 @@
+/* GStreamer G1 plugin
+ *
+ * Copyright (C) 2026 Microchip Technology Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "gstg1scheduler.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_g1_scheduler_debug);
+#define GST_CAT_DEFAULT gst_g1_scheduler_debug
+
+struct _GstG1SchedulerClient
+{
+  GstObject *owner;
+
+  GstG1SchedulerPolicy policy;
+  gint priority;
+
+  /* Pending job, if any */
+  gboolean waiting;
+  GstClockTime deadline;
+  guint64 ticket;
+
+  /* Grant sequence number of the last job run, for round robin */
+  guint64 served;
+
+  /* Hardware time accounting */
+  GstClockTime start;
+  GstClockTime busy_time;
+  guint64 jobs;
+};
+
+/* The G1 core is a single resource shared by every decoder in the
+   process, the lock protects the client list and the grant state */
+static GMutex _lock;
+static GCond _cond;
+static GList *_clients = NULL;
+static GstG1SchedulerClient *_holder = NULL;
+static guint64 _tickets = 0;
+static guint64 _grants = 0;
+
+GType
+gst_g1_scheduler_policy_get_type (void)
+{
+  static GType policy_type = 0;
+
+  static const GEnumValue policy_types[] = {
+    {GST_G1_SCHEDULER_ROUND_ROBIN, "Take turns with the other instances",
+        "round-robin"},
+    {GST_G1_SCHEDULER_DEADLINE, "Earliest presentation deadline first",
+        "deadline"},
+    {0, NULL, NULL}
+  };
+
+  if (!policy_type) {
+    policy_type =
+        g_enum_register_static ("GstG1SchedulerPolicy", policy_types);
+  }
+  return policy_type;
+}
+
+/* Whether job a should run before job b */
+static gboolean
+gst_g1_scheduler_before (GstG1SchedulerClient * a, GstG1SchedulerClient * b)
+{
+  if (a->priority != b->priority)
+    return a->priority > b->priority;
+
+  if (a->policy == GST_G1_SCHEDULER_DEADLINE &&
+      b->policy == GST_G1_SCHEDULER_DEADLINE &&
+      GST_CLOCK_TIME_IS_VALID (a->deadline) &&
+      GST_CLOCK_TIME_IS_VALID (b->deadline) && a->deadline != b->deadline)
+    return a->deadline < b->deadline;
+
+  if (a->served != b->served)
+    return a->served < b->served;
+
+  return a->ticket < b->ticket;
+}
+
+/* Must be called with the lock held */
+static GstG1SchedulerClient *
+gst_g1_scheduler_next (void)
+{
+  GstG1SchedulerClient *next = NULL;
+  GstG1SchedulerClient *client;
+  GList *iter;
+
+  for (iter = _clients; iter; iter = iter->next) {
+    client = iter->data;
+
+    if (!client->waiting)
+      continue;
+
+    if (!next || gst_g1_scheduler_before (client, next))
+      next = client;
+  }
+
+  return next;
+}
+
+GstG1SchedulerClient *
+gst_g1_scheduler_register (GstObject * owner)
+{
+  static gsize debug_init = 0;
+  GstG1SchedulerClient *client;
+
+  if (g_once_init_enter (&debug_init)) {
+    GST_DEBUG_CATEGORY_INIT (gst_g1_scheduler_debug, "g1scheduler", 0,
+        "G1 core scheduler");
+    g_once_init_leave (&debug_init, 1);
+  }
+
+  client = g_slice_new0 (GstG1SchedulerClient);
+  client->owner = owner;
+  client->policy = GST_G1_SCHEDULER_ROUND_ROBIN;
+  client->deadline = GST_CLOCK_TIME_NONE;
+  client->start = GST_CLOCK_TIME_NONE;
+
+  g_mutex_lock (&_lock);
+  /* Newcomers don't get to jump the queue */
+  client->served = _grants;
+  _clients = g_list_append (_clients, client);
+  g_mutex_unlock (&_lock);
+
+  GST_DEBUG_OBJECT (owner, "registered with the G1 scheduler");
+
+  return client;
+}
+
+void
+gst_g1_scheduler_unregister (GstG1SchedulerClient * client)
+{
+  g_return_if_fail (client);
+
+  g_mutex_lock (&_lock);
+  if (_holder == client) {
+    GST_WARNING_OBJECT (client->owner, "unregistering while holding the core");
+    _holder = NULL;
+  }
+  _clients = g_list_remove (_clients, client);
+  g_cond_broadcast (&_cond);
+  g_mutex_unlock (&_lock);
+
+  GST_DEBUG_OBJECT (client->owner, "used the core %" G_GUINT64_FORMAT
+      " times for %" GST_TIME_FORMAT, client->jobs,
+      GST_TIME_ARGS (client->busy_time));
+
+  g_slice_free (GstG1SchedulerClient, client);
+}
+
+void
+gst_g1_scheduler_configure (GstG1SchedulerClient * client,
+    GstG1SchedulerPolicy policy, gint priority)
+{
+  g_return_if_fail (client);
+
+  g_mutex_lock (&_lock);
+  client->policy = policy;
+  client->priority = priority;
+  /* The waiting order may have changed */
+  g_cond_broadcast (&_cond);
+  g_mutex_unlock (&_lock);
+}
+
+void
+gst_g1_scheduler_acquire (GstG1SchedulerClient * client,
+    GstClockTime deadline)
+{
+  GstClockTime start;
+
+  g_return_if_fail (client);
+
+  start = gst_util_get_timestamp ();
+
+  g_mutex_lock (&_lock);
+  client->waiting = TRUE;
+  client->deadline = deadline;
+  client->ticket = _tickets++;
+
+  while (_holder || gst_g1_scheduler_next () != client)
+    g_cond_wait (&_cond, &_lock);
+
+  client->waiting = FALSE;
+  client->served = ++_grants;
+  _holder = client;
+  g_mutex_unlock (&_lock);
+
+  client->start = gst_util_get_timestamp ();
+
+  GST_LOG_OBJECT (client->owner, "granted the core after %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (client->start - start));
+}
+
+void
+gst_g1_scheduler_release (GstG1SchedulerClient * client)
+{
+  GstClockTime elapsed;
+
+  g_return_if_fail (client);
+
+  elapsed = gst_util_get_timestamp () - client->start;
+
+  g_mutex_lock (&_lock);
+  g_warn_if_fail (_holder == client);
+
+  client->busy_time += elapsed;
+  client->jobs++;
+  client->start = GST_CLOCK_TIME_NONE;
+
+  _holder = NULL;
+  g_cond_broadcast (&_cond);
+  g_mutex_unlock (&_lock);
+
+  GST_LOG_OBJECT (client->owner, "held the core for %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (elapsed));
+}
+
+GstClockTime
+gst_g1_scheduler_get_busy_time (GstG1SchedulerClient * client, guint64 * jobs)
+{
+  GstClockTime busy_time;
+
+  g_return_val_if_fail (client, GST_CLOCK_TIME_NONE);
+
+  g_mutex_lock (&_lock);
+  busy_time = client->busy_time;
+  if (jobs)
+    *jobs = client->jobs;
+  g_mutex_unlock (&_lock);
+
+  return busy_time;
+}
@@ -0,0 +1,105 @@
+/* GStreamer G1 plugin
+ *
+ * Copyright (C) 2026 Microchip Technology Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _GST_G1_SCHEDULER_H_
+#define _GST_G1_SCHEDULER_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * How a client competes with the others of the same priority for the
+ * G1 core.
+ *
+ * @GST_G1_SCHEDULER_ROUND_ROBIN: Clients take turns, the one served least
+ * recently goes first.
+ * @GST_G1_SCHEDULER_DEADLINE: The job with the earliest deadline goes
+ * first. Jobs without a deadline fall back to taking turns.
+ */
+typedef enum
+{
+  GST_G1_SCHEDULER_ROUND_ROBIN,
+  GST_G1_SCHEDULER_DEADLINE,
+} GstG1SchedulerPolicy;
+
+#define GST_G1_SCHEDULER_POLICY_TYPE (gst_g1_scheduler_policy_get_type())
+GType gst_g1_scheduler_policy_get_type (void);
+
+typedef struct _GstG1SchedulerClient GstG1SchedulerClient;
+
+/**
+ * Registers a new user of the G1 core with the process wide scheduler.
+ * Every job the client runs on the hardware must be enclosed between
+ * gst_g1_scheduler_acquire() and gst_g1_scheduler_release().
+ *
+ * @param owner The object the client is logged as. No reference is
+ * taken, the owner must unregister the client before it is disposed.
+ *
+ * @return A new client, to be freed with gst_g1_scheduler_unregister()
+ */
+GstG1SchedulerClient *gst_g1_scheduler_register (GstObject * owner);
+
+/**
+ * Removes a client from the scheduler and frees it. The client must not
+ * hold the core.
+ *
+ * @param client A client returned by gst_g1_scheduler_register()
+ */
+void gst_g1_scheduler_unregister (GstG1SchedulerClient * client);
+
+/**
+ * Changes the way a client is scheduled. Takes effect on the next grant.
+ *
+ * @param client A registered client
+ * @param policy The ordering among clients of the same priority
+ * @param priority Clients with a higher priority are always served first
+ */
+void gst_g1_scheduler_configure (GstG1SchedulerClient * client,
+    GstG1SchedulerPolicy policy, gint priority);
+
+/**
+ * Blocks until the client is granted the G1 core.
+ *
+ * @param client A registered client
+ * @param deadline Clock time the job should be done by, used by the
+ * deadline policy, or GST_CLOCK_TIME_NONE.
+ */
+void gst_g1_scheduler_acquire (GstG1SchedulerClient * client,
+    GstClockTime deadline);
+
+/**
+ * Gives the G1 core back to the scheduler, and accounts the time it was
+ * held to the client.
+ *
+ * @param client The client holding the core
+ */
+void gst_g1_scheduler_release (GstG1SchedulerClient * client);
+
+/**
+ * Returns the hardware time used by a client so far
+ *
+ * @param client A registered client
+ * @param jobs Location for the amount of jobs run, or NULL
+ *
+ * @return The total time the client held the core
+ */
+GstClockTime gst_g1_scheduler_get_busy_time (GstG1SchedulerClient * client,
+    guint64 * jobs);
+
+G_END_DECLS
+#endif /*_GST_G1_SCHEDULER_H_*/
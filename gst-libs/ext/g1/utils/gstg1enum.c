@@ -39,3 +39,22 @@ gst_g1_enum_rotation_get_type ()
   }
   return rotation_type;
 }
+
+GType
+gst_g1_enum_deinterlace_get_type ()
+{
+  static GType deinterlace_type = 0;
+
+  static const GEnumValue deinterlace_types[] = {
+    {GST_G1_DEINTERLACE_AUTO, "Deinterlace interlaced streams", "auto"},
+    {GST_G1_DEINTERLACE_ON, "Always deinterlace", "on"},
+    {GST_G1_DEINTERLACE_OFF, "Never deinterlace", "off"},
+    {0, NULL, NULL}
+  };
+
+  if (!deinterlace_type) {
+    deinterlace_type =
+        g_enum_register_static ("GstG1EnumDeinterlaceType", deinterlace_types);
+  }
+  return deinterlace_type;
+}
@@ -25,5 +25,15 @@ G_BEGIN_DECLS
 #define GST_G1_ENUM_ROTATION_TYPE (gst_g1_enum_rotation_get_type())
 GType gst_g1_enum_rotation_get_type (void);
 
+typedef enum
+{
+  GST_G1_DEINTERLACE_AUTO,
+  GST_G1_DEINTERLACE_ON,
+  GST_G1_DEINTERLACE_OFF,
+} GstG1Deinterlace;
+
+#define GST_G1_ENUM_DEINTERLACE_TYPE (gst_g1_enum_deinterlace_get_type())
+GType gst_g1_enum_deinterlace_get_type (void);
+
 G_END_DECLS
 #endif //__GST_G1_ENUM_H__
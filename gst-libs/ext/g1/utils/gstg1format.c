@@ -32,13 +32,12 @@ gst_format_g1_to_gst (guint32 fmt)
       finfo.flags |= GST_VIDEO_FORMAT_FLAG_YUV;
       break;
     case H264DEC_TILED_YUV420:
+      /* Same planes as NV12 in 4x4 tiles, only the post processor
+         reads them */
       finfo.name = "NV12";
       finfo.description = "tiled semiplanar 4:2:0 YUV";
       finfo.format = GST_VIDEO_FORMAT_NV12;
       finfo.flags |= GST_VIDEO_FORMAT_FLAG_YUV;
-      /* This version of gstreamer doesn't have support for tiles yet */
-      //finfo.flags |= GST_VIDEO_FORMAT_FLAG_TILED;
-      g_return_val_if_reached (finfo);
       break;
     case H264DEC_YUV400:
       finfo.name = "GRAY8";
@@ -53,6 +52,21 @@ gst_format_g1_to_gst (guint32 fmt)
 }
 
 
+guint32
+gst_format_g1_to_pp (guint32 fmt)
+{
+  switch (fmt) {
+    case H264DEC_SEMIPLANAR_YUV420:
+      return PP_PIX_FMT_YCBCR_4_2_0_SEMIPLANAR;
+    case H264DEC_TILED_YUV420:
+      return PP_PIX_FMT_YCBCR_4_2_0_TILED;
+    case H264DEC_YUV400:
+      return PP_PIX_FMT_YCBCR_4_0_0;
+    default:
+      g_return_val_if_reached (-1);
+  }
+}
+
 static const struct
 {
   GstVideoFormat format;
@@ -86,3 +100,19 @@ gst_format_gst_to_g1 (GstVideoFormatInfo * finfo)
 
   g_return_val_if_reached (-1);
 }
+
+void
+gst_format_g1_align (GstVideoInfo * vinfo)
+{
+  GstVideoAlignment align;
+
+  g_return_if_fail (vinfo);
+
+  gst_video_alignment_reset (&align);
+  align.padding_right = GST_ROUND_UP_16 (GST_VIDEO_INFO_WIDTH (vinfo)) -
+      GST_VIDEO_INFO_WIDTH (vinfo);
+  align.padding_bottom = GST_ROUND_UP_16 (GST_VIDEO_INFO_HEIGHT (vinfo)) -
+      GST_VIDEO_INFO_HEIGHT (vinfo);
+
+  gst_video_info_align (vinfo, &align);
+}
@@ -30,7 +30,14 @@ G_BEGIN_DECLS
 
 GstVideoFormatInfo gst_format_g1_to_gst (guint32 fmt);
 
+/* Post processor input format for pictures in a decoder output format */
+guint32 gst_format_g1_to_pp (guint32 fmt);
+
 guint32 gst_format_gst_to_g1 (GstVideoFormatInfo * finfo);
 
+/* Pads the image to the 16 pixel alignment the post processor writes,
+ * updating the plane strides, offsets and total size accordingly */
+void gst_format_g1_align (GstVideoInfo * vinfo);
+
 G_END_DECLS
 #endif //__GST_G1_FORMAT_H__